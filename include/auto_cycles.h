@@ -0,0 +1,50 @@
+/*
+ *  Copyright (C) 2002-2020  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_AUTO_CYCLES_H
+#define DOSBOX_AUTO_CYCLES_H
+
+#ifndef DOSBOX_DOSBOX_H
+#include "dosbox.h"
+#endif
+
+/* Cycles controller for cycles=auto and cycles=max.
+ * The main loop reports the emulated ticks it ran and the host time it
+ * slept. Over short windows the controller measures how much host time
+ * one emulated millisecond costs and steers CPU_CycleMax with a PID loop
+ * towards the host CPU share asked for (90% of the cycles percentage). */
+
+class Section;
+
+void AUTOCYCLES_Init(Section *sec);
+
+// Start over, after changes that make the past measurements meaningless
+void AUTOCYCLES_Reset();
+
+// Emulated ticks that ran at the current CPU_CycleMax
+void AUTOCYCLES_AddTicks(Bit32u ticks);
+
+// Host time spent sleeping, in nanoseconds
+void AUTOCYCLES_AddSleep(Bit64s ns);
+
+// Called when new ticks get scheduled, returns true when a window was
+// closed and CPU_CycleMax possibly changed. lagging is set when the host
+// couldn't keep up with real time.
+bool AUTOCYCLES_Update(bool lagging);
+
+#endif
@@ -70,6 +70,10 @@ extern CPU_Decoder * cpudecoder;
 
 Bits CPU_Core_Normal_Run(void);
 Bits CPU_Core_Normal_Trap_Run(void);
+/* Give a page with predecoded instructions (PFLAG_PREDECODED) back to its
+   previous handler, before another core installs its own handler there */
+class PageHandler;
+void CPU_Core_Normal_ReleasePage(PageHandler * handler);
 Bits CPU_Core_Simple_Run(void);
 Bits CPU_Core_Simple_Trap_Run(void);
 Bits CPU_Core_Full_Run(void);
@@ -127,6 +131,8 @@ void CPU_CALL(bool use32,Bitu selector,Bitu offset,Bitu oldeip);
 void CPU_RET(bool use32,Bitu bytes,Bitu oldeip);
 void CPU_IRET(bool use32,Bitu oldeip);
 void CPU_HLT(Bitu oldeip);
+/* True while the cpu waits in HLT for an interrupt */
+bool CPU_IsHalted(void);
 
 bool CPU_POPF(Bitu use32);
 bool CPU_PUSHF(Bitu use32);
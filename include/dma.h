@@ -34,6 +34,8 @@ enum DMAEvent {
 };
 
 class DmaChannel;
+class SnapshotReader;
+class SnapshotWriter;
 using DMA_CallBack = std::function<void(DmaChannel *chan, DMAEvent event)>;
 
 class DmaChannel {
@@ -124,6 +126,10 @@ public:
 
 	void WriteControllerReg(Bitu reg,Bitu val,Bitu len);
 	Bitu ReadControllerReg(Bitu reg,Bitu len);
+
+	/* The channel callbacks stay, devices restore their side themselves */
+	void SaveState(SnapshotWriter &out) const;
+	bool LoadState(SnapshotReader &in, bool apply);
 };
 
 DmaChannel * GetDMAChannel(Bit8u chan);
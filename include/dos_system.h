@@ -134,6 +134,7 @@ public:
 	virtual bool	ReadFromControlChannel(PhysPt bufptr,Bit16u size,Bit16u * retcode);
 	virtual bool	WriteToControlChannel(PhysPt bufptr,Bit16u size,Bit16u * retcode);
 	void SetDeviceNumber(Bitu num) { devnum=num;}
+	Bitu GetDeviceNumber(void) const { return devnum;}
 private:
 	Bitu devnum;
 };
@@ -34,6 +34,8 @@ class Section;
 typedef Bitu (LoopHandler)(void);
 
 void DOSBOX_RunMachine();
+/* Number of DOSBOX_RunMachine calls currently on the host stack */
+Bitu DOSBOX_GetRunDepth();
 void DOSBOX_SetLoop(LoopHandler * handler);
 void DOSBOX_SetNormalLoop();
 
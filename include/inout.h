@@ -40,6 +40,11 @@ using io_val_t_proposed = uint32_t; // Handling exists up to a dword (or less)
 using IO_ReadHandler = std::function<Bitu(io_port_t port, Bitu iolen)>;
 using IO_WriteHandler = std::function<void(io_port_t port, io_val_t val, Bitu iolen)>;
 
+// Plain handler functions, which most devices register, are called
+// directly instead of through the std::function wrapper
+using IO_ReadFunction = Bitu (*)(io_port_t port, Bitu iolen);
+using IO_WriteFunction = void (*)(io_port_t port, io_val_t val, Bitu iolen);
+
 extern std::unordered_map<io_port_t, IO_WriteHandler> io_writehandlers[IO_SIZES];
 extern std::unordered_map<io_port_t, IO_ReadHandler> io_readhandlers[IO_SIZES];
 
@@ -34,6 +34,7 @@ typedef Bit32s MemHandle;
 #define MEM_PAGESIZE 4096
 
 extern HostPt MemBase;
+extern bool MemDirtyTracking;	//Set through MEM_SetDirtyTracking
 HostPt GetMemBase(void);
 
 bool MEM_A20_Enabled(void);
@@ -54,6 +55,16 @@ bool MEM_ReAllocatePages(MemHandle & handle,Bitu pages,bool sequence);
 MemHandle MEM_NextHandle(MemHandle handle);
 MemHandle MEM_NextHandleAt(MemHandle handle,Bitu where);
 
+/* Dirty page tracking. While enabled, clean RAM pages are linked into the
+ * TLB without a write pointer: the first write goes through the page
+ * handler, which marks the page dirty and links it writable again. */
+void MEM_SetDirtyTracking(bool enable);
+bool MEM_DirtyTrackingEnabled(void);
+bool MEM_PageDirty(Bitu phys_page);		//Also true for translated code and Tandy/PCjr video RAM
+void MEM_MarkPageDirty(Bitu phys_page);	//For writes that bypass the TLB
+void MEM_ClearDirtyPages(void);
+bool MEM_PageWriteTrapped(Bitu phys_page);
+
 static INLINE void var_write(uint8_t *var, uint8_t val)
 {
 	host_writeb(var, val);
@@ -85,13 +96,24 @@ void mem_writeb(PhysPt pt,Bit8u val);
 void mem_writew(PhysPt pt,Bit16u val);
 void mem_writed(PhysPt pt,Bit32u val);
 
+/* Writes straight to MemBase bypass the TLB write trap */
+static INLINE void phys_markdirty(PhysPt addr,Bitu size) {
+	if (GCC_UNLIKELY(MemDirtyTracking)) {
+		MEM_MarkPageDirty(addr/MEM_PAGESIZE);
+		MEM_MarkPageDirty((addr+size-1)/MEM_PAGESIZE);
+	}
+}
+
 static INLINE void phys_writeb(PhysPt addr,Bit8u val) {
+	phys_markdirty(addr,1);
 	host_writeb(MemBase+addr,val);
 }
 static INLINE void phys_writew(PhysPt addr,Bit16u val){
+	phys_markdirty(addr,2);
 	host_writew(MemBase+addr,val);
 }
 static INLINE void phys_writed(PhysPt addr,Bit32u val){
+	phys_markdirty(addr,4);
 	host_writed(MemBase+addr,val);
 }
 
@@ -30,6 +30,7 @@ class Program;
 
 void MIDI_Init(Section *sec);
 bool MIDI_Available();
+bool MIDI_DeviceOpen(); // Data goes to a real device, not the none handler
 void MIDI_ListAll(Program *output_handler);
 void MIDI_RawOutByte(uint8_t data);
 
@@ -62,6 +62,7 @@ public:
 	void MapChannels(Bit8u _left, Bit8u _right);
 	void UpdateVolume();
 	void SetFreq(Bitu _freq);
+	uint32_t GetSampleRate() const { return sample_rate; }
 	void SetPeakAmplitude(uint32_t peak);
 	void Mix(Bitu _needed);
 	void AddSilence(); // Fill up until needed
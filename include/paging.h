@@ -48,6 +48,8 @@ class PageDirectory;
 #define PFLAG_NOCODE		0x10			//No dynamic code can be generated here
 #define PFLAG_INIT			0x20			//No dynamic code can be generated here
 #define PFLAG_HASCODE16		0x40			//Page contains 16-bit dynamic code
+#define PFLAG_WRITEBLOCK	0x80			//Handler implements writeblock
+#define PFLAG_PREDECODED	0x100			//Page contains predecoded normal core instructions
 #define PFLAG_HASCODE		(PFLAG_HASCODE32|PFLAG_HASCODE16)
 
 #define LINK_START	((1024+64)/4)			//Start right after the HMA
@@ -73,6 +75,11 @@ public:
 	virtual bool writeb_checked(PhysPt addr,Bitu val);
 	virtual bool writew_checked(PhysPt addr,Bitu val);
 	virtual bool writed_checked(PhysPt addr,Bitu val);
+	/* Write count bytes to one page in a single call, for handlers without
+	   host pointers that can do better than a byte at a time (they set
+	   PFLAG_WRITEBLOCK). Returns false without writing anything if the
+	   handler can't take the block */
+	virtual bool writeblock(PhysPt addr,const Bit8u * data,Bitu count);
 
 	Bitu flags = 0x0;
 };
@@ -139,7 +146,19 @@ union X86PageEntry {
 	X86_PageEntryBlock block;
 };
 
-#if !defined(USE_FULL_TLB)
+#if defined(USE_FULL_TLB)
+/* All pointers a memory access needs for one linear page sit next to each
+   other, so an access touches a single cache line. The table lives in bss
+   and an all zero entry means the page still has to be initialized, which
+   leaves the host pages of untouched 4 MB regions unpopulated. */
+typedef struct {
+	HostPt read;
+	HostPt write;
+	PageHandler * readhandler;
+	PageHandler * writehandler;
+} tlb_entry;
+static_assert(sizeof(tlb_entry)==4*sizeof(HostPt),"the dynamic core scales tlb indices by four pointers");
+#else
 typedef struct {
 	HostPt read;
 	HostPt write;
@@ -158,10 +177,7 @@ struct PagingBlock {
 	} base;
 #if defined(USE_FULL_TLB)
 	struct {
-		HostPt read[TLB_SIZE];
-		HostPt write[TLB_SIZE];
-		PageHandler * readhandler[TLB_SIZE];
-		PageHandler * writehandler[TLB_SIZE];
+		tlb_entry entries[TLB_SIZE];
 		Bit32u	phys_page[TLB_SIZE];
 	} tlb;
 #else
@@ -178,6 +194,11 @@ struct PagingBlock {
 
 extern PagingBlock paging; 
 
+#if defined(USE_FULL_TLB)
+/* Handler of pages whose tlb entry is still zero */
+extern PageHandler * const paging_init_handler;
+#endif
+
 /* Some support functions */
 
 PageHandler * MEM_GetPageHandler(Bitu phys_page);
@@ -197,16 +218,18 @@ bool mem_unalignedwrited_checked(PhysPt address,Bit32u val);
 #if defined(USE_FULL_TLB)
 
 static INLINE HostPt get_tlb_read(PhysPt address) {
-	return paging.tlb.read[address>>12];
+	return paging.tlb.entries[address>>12].read;
 }
 static INLINE HostPt get_tlb_write(PhysPt address) {
-	return paging.tlb.write[address>>12];
+	return paging.tlb.entries[address>>12].write;
 }
 static INLINE PageHandler* get_tlb_readhandler(PhysPt address) {
-	return paging.tlb.readhandler[address>>12];
+	PageHandler * handler=paging.tlb.entries[address>>12].readhandler;
+	return handler ? handler : paging_init_handler;
 }
 static INLINE PageHandler* get_tlb_writehandler(PhysPt address) {
-	return paging.tlb.writehandler[address>>12];
+	PageHandler * handler=paging.tlb.entries[address>>12].writehandler;
+	return handler ? handler : paging_init_handler;
 }
 
 /* Use these helper functions to access linear addresses in readX/writeX functions */
@@ -27,6 +27,8 @@ extern Bit32s CPU_CycleMax;
 
 typedef void (PIC_EOIHandler) (void);
 typedef void (* PIC_EventHandler)(Bitu val);
+/* Identifies one added event, stays safe to use after the event ran */
+typedef Bit64u PIC_EventHandle;
 
 
 extern Bitu PIC_IRQCheck;
@@ -55,9 +57,17 @@ void PIC_runIRQs(void);
 bool PIC_RunQueue(void);
 
 //Delay in milliseconds
-void PIC_AddEvent(PIC_EventHandler handler,float delay,Bitu val=0);
+PIC_EventHandle PIC_AddEvent(PIC_EventHandler handler,double delay,Bitu val=0);
+void PIC_RemoveEvent(PIC_EventHandle handle);
 void PIC_RemoveEvents(PIC_EventHandler handler);
 void PIC_RemoveSpecificEvents(PIC_EventHandler handler, Bitu val);
+//Milliseconds until the first pending event, false if there is none
+bool PIC_NextEventDelay(double & delay);
 
 void PIC_SetIRQMask(Bitu irq, bool masked);
+
+/* Pending events of registered handlers are part of machine state snapshots,
+ * the name stands for the handler in the snapshot file. The other events are
+ * kept on load, devices without snapshot state reschedule their own. */
+void PIC_RegisterSnapshotEvent(const char *name, PIC_EventHandler handler);
 #endif
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (C) 2002-2020  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_SNAPSHOT_H
+#define DOSBOX_SNAPSHOT_H
+
+#ifndef DOSBOX_DOSBOX_H
+#include "dosbox.h"
+#endif
+
+#include <cstring>
+#include <vector>
+
+/* Machine state snapshots.
+ * Every part of the emulator that wants to be saved registers a named
+ * component with a version. A snapshot file holds one record per component.
+ * A snapshot only loads when its records match the registered components
+ * one to one, by name and version. */
+
+class SnapshotWriter {
+public:
+	void Write(const void *data, size_t size)
+	{
+		const Bit8u *bytes = static_cast<const Bit8u *>(data);
+		buffer.insert(buffer.end(), bytes, bytes + size);
+	}
+	template <typename T>
+	void Write(const T &value)
+	{
+		Write(&value, sizeof(T));
+	}
+	std::vector<Bit8u> buffer = {};
+};
+
+class SnapshotReader {
+public:
+	SnapshotReader(const Bit8u *data, size_t size) : pos(data), end(data + size) {}
+	bool Read(void *data, size_t size)
+	{
+		if (static_cast<size_t>(end - pos) < size)
+			return false;
+		memcpy(data, pos, size);
+		pos += size;
+		return true;
+	}
+	template <typename T>
+	bool Read(T &value)
+	{
+		return Read(&value, sizeof(T));
+	}
+	bool Skip(size_t size)
+	{
+		if (static_cast<size_t>(end - pos) < size)
+			return false;
+		pos += size;
+		return true;
+	}
+	bool AtEnd() const { return pos == end; }
+
+private:
+	const Bit8u *pos;
+	const Bit8u *end;
+};
+
+/* A load handler is called twice per record. With apply false it only
+ * checks the record and must not change any state, with apply true (once
+ * every record passed) it restores the state and can no longer fail. The
+ * records are applied in the order the components were registered. */
+typedef void (SNAPSHOT_SaveHandler)(SnapshotWriter &out);
+typedef bool (SNAPSHOT_LoadHandler)(SnapshotReader &in, bool apply);
+
+void SNAPSHOT_Register(const char *name, Bit32u version,
+                       SNAPSHOT_SaveHandler *save, SNAPSHOT_LoadHandler *load);
+void SNAPSHOT_Unregister(const char *name);
+
+/* Bulky data (video and sound card memory) in a record, zlib compressed
+ * in builds that link zlib. Reading with data null only checks the block. */
+void SNAPSHOT_WriteBlock(SnapshotWriter &out, const void *data, size_t size);
+bool SNAPSHOT_ReadBlock(SnapshotReader &in, void *data, size_t size);
+
+bool SNAPSHOT_Save(const char *filename);
+bool SNAPSHOT_Load(const char *filename);
+
+/* Hotkey requests are carried out between two emulation ticks */
+void SNAPSHOT_RunPending(void);
+void SNAPSHOT_Init(Section *sec);
+
+#endif
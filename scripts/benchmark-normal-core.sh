@@ -0,0 +1,135 @@
+#!/bin/bash
+
+# Copyright (C) 2020  The dosbox-staging team
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# This script measures how fast the normal CPU core interprets a CPU bound
+# loop, so a default build can be compared with one configured with
+# --enable-threaded-core (or with different compilers and flags).
+#
+# Usage: ./benchmark-normal-core.sh [-l LOOPS] [-r RUNS] DOSBOX...
+# Example:
+#   ./benchmark-normal-core.sh build-switch/src/dosbox build-threaded/src/dosbox
+#
+# Every binary runs a small COM program with core=normal and cycles=max,
+# headless and without sound. The program executes LOOPS (default: 1000)
+# times 65536 iterations of a 5 instruction loop. The time of a run that
+# only starts and exits DOS is subtracted, and the best of RUNS (default: 3)
+# runs is reported in millions of emulated instructions per second.
+
+set -euo pipefail
+
+loops=1000
+runs=3
+
+usage () {
+	echo "Usage:   $0 [-l LOOPS] [-r RUNS] DOSBOX..."
+	echo "Example: $0 build-switch/src/dosbox build-threaded/src/dosbox"
+	exit 1
+}
+
+while getopts "l:r:h" opt; do
+	case "$opt" in
+	l) loops="$OPTARG" ;;
+	r) runs="$OPTARG" ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [[ "$#" -lt 1 ]] || [[ "$loops" -lt 1 ]] || [[ "$loops" -gt 65535 ]] \
+	|| [[ "$runs" -lt 1 ]]; then
+	usage
+fi
+
+workdir="$(mktemp -d)"
+trap 'rm -rf "$workdir"' EXIT
+
+# bench.com:
+#   mov dx,LOOPS
+# outer:
+#   mov cx,0
+# inner:
+#   add ax,bx
+#   xor bx,ax
+#   inc si
+#   dec di
+#   loop inner
+#   dec dx
+#   jnz outer
+#   mov ax,4c00h
+#   int 21h
+write_bench_com () {
+	local lo hi
+	lo="$(printf '\\x%02x' $(($1 & 0xff)))"
+	hi="$(printf '\\x%02x' $(($1 >> 8)))"
+	# shellcheck disable=SC2059
+	printf "\\xba${lo}${hi}\\xb9\\x00\\x00\\x01\\xd8\\x31\\xc3\\x46\\x4f\\xe2\\xf8\\x4a\\x75\\xf2\\xb8\\x00\\x4c\\xcd\\x21" \
+		> "$2"
+}
+
+# empty.com: mov ax,4c00h; int 21h
+printf '\xb8\x00\x4c\xcd\x21' > "$workdir/empty.com"
+write_bench_com "$loops" "$workdir/bench.com"
+
+# instructions executed by bench.com
+instructions=$((loops * (65536 * 5 + 3) + 3))
+
+cat > "$workdir/bench.conf" <<EOF
+[sdl]
+output=surface
+[cpu]
+core=normal
+cycles=max
+[mixer]
+nosound=true
+[midi]
+mididevice=none
+[speaker]
+pcspeaker=false
+tandy=off
+[autoexec]
+mount c "$workdir"
+c:
+EOF
+
+# prints the seconds needed for one run of the given program
+time_run () {
+	local start end
+	start="$(date +%s.%N)"
+	SDL_VIDEODRIVER=dummy SDL_AUDIODRIVER=dummy \
+		"$1" -conf "$workdir/bench.conf" -c "$2" -exit > /dev/null 2>&1
+	end="$(date +%s.%N)"
+	awk -v start="$start" -v end="$end" 'BEGIN { print end - start }'
+}
+
+# prints the lowest of the given numbers
+minimum () {
+	printf '%s\n' "$@" | sort -g | head -n 1
+}
+
+echo "Running $instructions instructions, best of $runs runs"
+for dosbox in "$@"; do
+	if [[ ! -x "$dosbox" ]]; then
+		echo "$dosbox: not an executable" >&2
+		exit 1
+	fi
+	empty_times=()
+	bench_times=()
+	for ((i = 0; i < runs; i++)); do
+		empty_times+=("$(time_run "$dosbox" empty.com)")
+		bench_times+=("$(time_run "$dosbox" bench.com)")
+	done
+	startup="$(minimum "${empty_times[@]}")"
+	total="$(minimum "${bench_times[@]}")"
+	awk -v dosbox="$dosbox" -v total="$total" -v startup="$startup" \
+		-v instructions="$instructions" 'BEGIN {
+		seconds = total - startup
+		if (seconds <= 0) {
+			print dosbox ": run too short, use more loops" > "/dev/stderr"
+			exit 1
+		}
+		printf "%s: %.2f s, %.1f MIPS\n", dosbox, seconds,
+			instructions / seconds / 1000000
+	}'
+done
@@ -161,6 +161,7 @@ static struct {
 #define IllegalOption(msg) E_Exit("DYNX86: illegal option in " msg)
 
 #include "dyn_cache.h" 
+#include "string_bulk.h"
 
 static struct {
 	Bitu callback;
@@ -252,6 +253,17 @@ static void dyn_restoreregister(DynReg * src_reg, DynReg * dst_reg) {
 
 #include "core_dyn_x86/decoder.h"
 
+static void dyn_cache_grow() {
+	if (!cache_grow()) return;
+#if C_TARGETCPU == X86_64
+	// the entry/exit stubs were placed in the old cache, regenerate them
+	gen_runcode = gen_runcodeInit;
+#if defined(X86_DYNFPU_DH_ENABLED)
+	gen_dh_fpu_save = gen_dh_fpu_saveInit;
+#endif
+#endif
+}
+
 Bits CPU_Core_Dyn_X86_Run(void) {
 	// helper class to auto-save DH_FPU state on function exit
 	class auto_dh_fpu {
@@ -268,6 +280,7 @@ Bits CPU_Core_Dyn_X86_Run(void) {
 
 	/* Determine the linear address of CS:EIP */
 restart_core:
+	if (GCC_UNLIKELY(cache_growth.pending)) dyn_cache_grow();
 	PhysPt ip_point=SegPhys(cs)+reg_eip;
 #if C_DEBUG
 #if C_HEAVY_DEBUG
@@ -465,6 +478,10 @@ void CPU_Core_Dyn_X86_Cache_Init(bool enable_cache) {
 	cache_init(enable_cache);
 }
 
+void CPU_Core_Dyn_X86_SetCacheSize(Bitu size_mb, bool growable) {
+	cache_set_size(size_mb, growable);
+}
+
 void CPU_Core_Dyn_X86_Cache_Close(void) {
 	cache_close();
 }
@@ -56,6 +56,11 @@ static bool MakeCodePage(Bitu lin_addr,CodePageHandler * &cph) {
 	//Ensure page contains memory:
 	if (GCC_UNLIKELY(mem_readb_checked(lin_addr,&rdval))) return true;
 	PageHandler * handler=get_tlb_readhandler(lin_addr);
+	if (handler->flags & PFLAG_PREDECODED) {
+		// the normal core kept decoded instructions here, take the page over
+		CPU_Core_Normal_ReleasePage(handler);
+		handler=get_tlb_readhandler(lin_addr);
+	}
 	if (handler->flags & PFLAG_HASCODE) {
 		cph=( CodePageHandler *)handler;
 		if (handler->flags & cflag) return false;
@@ -87,6 +92,7 @@ static bool MakeCodePage(Bitu lin_addr,CodePageHandler * &cph) {
 	}
 	/* Find a free CodePage */
 	if (!cache.free_pages && cache.used_pages) {
+		cache_note_eviction();
 		if (cache.used_pages != decode.page.code)
 			cache.used_pages->ClearRelease();
 		else {
@@ -530,9 +536,11 @@ static void dyn_read_byte(DynReg * addr,DynReg * dst,bool high,bool release=fals
 
 	cache_addw(0xe8c1);		// shr eax,0x0c
 	cache_addb(0x0c);
-	cache_addw(0x048b);		// mov eax,paging.tlb.read[eax*TYPE Bit32u]
+	cache_addw(0xe0c1);		// shl eax,2 (tlb entries are four pointers)
+	cache_addb(0x02);
+	cache_addw(0x048b);		// mov eax,paging.tlb.entries[eax*TYPE tlb_entry].read
 	cache_addb(0x85);
-	cache_addd((Bit32u)(&paging.tlb.read[0]));
+	cache_addd((Bit32u)(&paging.tlb.entries[0].read));
 	cache_addw(0xc085);		// test eax,eax
 	Bit8u* je_loc=gen_create_branch(BR_Z);
 
@@ -607,9 +615,11 @@ static void dyn_read_word(DynReg * addr,DynReg * dst,bool dword,bool release=fal
 	Bit8u* jb_loc1=gen_create_branch(BR_NB);
 	cache_addb(0x25);       // and eax, 0x000FFFFF
 	cache_addd(0x000fffff);
-	cache_addw(0x048b);		// mov eax,paging.tlb.read[eax*TYPE Bit32u]
+	cache_addw(0xe0c1);		// shl eax,2 (tlb entries are four pointers)
+	cache_addb(0x02);
+	cache_addw(0x048b);		// mov eax,paging.tlb.entries[eax*TYPE tlb_entry].read
 	cache_addb(0x85);
-	cache_addd((Bit32u)(&paging.tlb.read[0]));
+	cache_addd((Bit32u)(&paging.tlb.entries[0].read));
 	cache_addw(0xc085);		// test eax,eax
 	Bit8u* je_loc=gen_create_branch(BR_Z);
 
@@ -678,9 +688,11 @@ static void dyn_write_byte(DynReg * addr,DynReg * val,bool high,bool release=fal
 	GenReg * genreg=FindDynReg(val);
 	cache_addw(0xe9c1);		// shr ecx,0x0c
 	cache_addb(0x0c);
-	cache_addw(0x0c8b);		// mov ecx,paging.tlb.write[ecx*TYPE Bit32u]
+	cache_addw(0xe1c1);		// shl ecx,2 (tlb entries are four pointers)
+	cache_addb(0x02);
+	cache_addw(0x0c8b);		// mov ecx,paging.tlb.entries[ecx*TYPE tlb_entry].write
 	cache_addb(0x8d);
-	cache_addd((Bit32u)(&paging.tlb.write[0]));
+	cache_addd((Bit32u)(&paging.tlb.entries[0].write));
 	cache_addw(0xc985);		// test ecx,ecx
 	Bit8u* je_loc=gen_create_branch(BR_Z);
 
@@ -722,9 +734,11 @@ static void dyn_write_word(DynReg * addr,DynReg * val,bool dword,bool release=fa
 	Bit8u* jb_loc1=gen_create_branch(BR_NB);
 	cache_addw(0xe181);     // and ecx, 0x000FFFFF
 	cache_addd(0x000fffff);
-	cache_addw(0x0c8b);		// mov ecx,paging.tlb.write[ecx*TYPE Bit32u]
+	cache_addw(0xe1c1);		// shl ecx,2 (tlb entries are four pointers)
+	cache_addb(0x02);
+	cache_addw(0x0c8b);		// mov ecx,paging.tlb.entries[ecx*TYPE tlb_entry].write
 	cache_addb(0x8d);
-	cache_addd((Bit32u)(&paging.tlb.write[0]));
+	cache_addd((Bit32u)(&paging.tlb.entries[0].write));
 	cache_addw(0xc985);		// test ecx,ecx
 	Bit8u* je_loc=gen_create_branch(BR_Z);
 
@@ -806,8 +820,9 @@ static void dyn_read_word(DynReg * addr,DynReg * dst,bool dword,bool release=fal
 	}
 
 	opcode(5).setrm(tmp).setimm(12,1).Emit8(0xC1); // shr tmpd,12
-	// mov tmp, [8*tmp+paging.tlb.read(rbp)]
-	opcode(tmp).set64().setea(5,tmp,3,(Bits)paging.tlb.read-(Bits)&cpu_regs).Emit8(0x8B);
+	opcode(4).setrm(tmp).setimm(2,1).Emit8(0xC1); // shl tmpd,2 (tlb entries are four pointers)
+	// mov tmp, [8*tmp+paging.tlb.entries[0].read(rbp)]
+	opcode(tmp).set64().setea(5,tmp,3,(Bits)&paging.tlb.entries[0].read-(Bits)&cpu_regs).Emit8(0x8B);
 	opcode(tmp).set64().setrm(tmp).Emit8(0x85); // test tmp,tmp
 	Bit8u *nomap=gen_create_branch(BR_Z);
 	//mov dst, [tmp+src]
@@ -852,8 +867,9 @@ static void dyn_read_byte(DynReg * addr,DynReg * dst,bool high,bool release=fals
 
 	opcode(tmp).setrm(gensrc->index).Emit8(0x8B); // mov tmp, src
 	opcode(5).setrm(tmp).setimm(12,1).Emit8(0xC1); // shr tmp,12
-	// mov tmp, [8*tmp+paging.tlb.read(rbp)]
-	opcode(tmp).set64().setea(5,tmp,3,(Bits)paging.tlb.read-(Bits)&cpu_regs).Emit8(0x8B);
+	opcode(4).setrm(tmp).setimm(2,1).Emit8(0xC1); // shl tmpd,2 (tlb entries are four pointers)
+	// mov tmp, [8*tmp+paging.tlb.entries[0].read(rbp)]
+	opcode(tmp).set64().setea(5,tmp,3,(Bits)&paging.tlb.entries[0].read-(Bits)&cpu_regs).Emit8(0x8B);
 	opcode(tmp).set64().setrm(tmp).Emit8(0x85); // test tmp,tmp
 	Bit8u *nomap=gen_create_branch(BR_Z);
 
@@ -909,8 +925,9 @@ static void dyn_write_word(DynReg * addr,DynReg * val,bool dword,bool release=fa
 	}
 
 	opcode(5).setrm(tmp).setimm(12,1).Emit8(0xC1); // shr tmpd,12
-	// mov tmp, [8*tmp+paging.tlb.write(rbp)]
-	opcode(tmp).set64().setea(5,tmp,3,(Bits)paging.tlb.write-(Bits)&cpu_regs).Emit8(0x8B);
+	opcode(4).setrm(tmp).setimm(2,1).Emit8(0xC1); // shl tmpd,2 (tlb entries are four pointers)
+	// mov tmp, [8*tmp+paging.tlb.entries[0].write(rbp)]
+	opcode(tmp).set64().setea(5,tmp,3,(Bits)&paging.tlb.entries[0].write-(Bits)&cpu_regs).Emit8(0x8B);
 	opcode(tmp).set64().setrm(tmp).Emit8(0x85); // test tmp,tmp
 	Bit8u *nomap=gen_create_branch(BR_Z);
 	//mov [tmp+src], dst
@@ -950,8 +967,9 @@ static void dyn_write_byte(DynReg * addr,DynReg * val,bool high,bool release=fal
 
 	opcode(tmp).setrm(gendst->index).Emit8(0x8B); // mov tmpd, dst
 	opcode(5).setrm(tmp).setimm(12,1).Emit8(0xC1); // shr tmpd,12
-	// mov tmp, [8*tmp+paging.tlb.write(rbp)]
-	opcode(tmp).set64().setea(5,tmp,3,(Bits)paging.tlb.write-(Bits)&cpu_regs).Emit8(0x8B);
+	opcode(4).setrm(tmp).setimm(2,1).Emit8(0xC1); // shl tmpd,2 (tlb entries are four pointers)
+	// mov tmp, [8*tmp+paging.tlb.entries[0].write(rbp)]
+	opcode(tmp).set64().setea(5,tmp,3,(Bits)&paging.tlb.entries[0].write-(Bits)&cpu_regs).Emit8(0x8B);
 	opcode(tmp).set64().setrm(tmp).Emit8(0x85); // test tmp,tmp
 	Bit8u *nomap=gen_create_branch(BR_Z);
 
@@ -26,6 +26,32 @@ enum STRING_OP {
 	STR_CMPSB=24,STR_CMPSW,STR_CMPSD
 };
 
+/* Called in front of the element loop of rep movs and stos. Does the runs
+   that can be done on host memory, but leaves at least one cycle so the
+   loop still ends the block when the cycles run out. */
+static void dyn_string_bulk(Bitu op,Bitu big_addr,PhysPt si_base,PhysPt di_base) {
+	const Bitu add_mask=big_addr ? 0xffffffff : 0xffff;
+	const Bits add_index=cpu.direction << (op & 3);
+	Bitu si_index=reg_esi & add_mask;
+	Bitu di_index=reg_edi & add_mask;
+	Bitu count=reg_ecx & add_mask;
+	while (count>0 && CPU_Cycles>1) {
+		Bitu limit=(Bitu)(CPU_Cycles-1);
+		if (limit>count) limit=count;
+		Bitu run;
+		if (op<=STR_MOVSD) run=StringBulkMovs(si_base,si_index,di_base,di_index,add_mask,add_index,limit);
+		else run=StringBulkStos(di_base,di_index,add_mask,add_index,limit,reg_eax);
+		if (!run) break;
+		si_index=(si_index+add_index*run) & add_mask;
+		di_index=(di_index+add_index*run) & add_mask;
+		count-=run;
+		CPU_Cycles-=(Bit32s)run;
+	}
+	reg_esi=(reg_esi & ~add_mask) | si_index;
+	reg_edi=(reg_edi & ~add_mask) | di_index;
+	reg_ecx=(reg_ecx & ~add_mask) | count;
+}
+
 static void dyn_string(STRING_OP op) {
 	DynReg * si_base=decode.segprefix ? decode.segprefix : DREG(DS);
 	DynReg * di_base=DREG(ES);
@@ -35,6 +61,18 @@ static void dyn_string(STRING_OP op) {
 		gen_dop_word_imm(DOP_SUB,true,DREG(CYCLES),decode.cycles);
 		gen_releasereg(DREG(CYCLES));
 		decode.cycles=0;
+		switch (op) {
+		case STR_MOVSB:	case STR_MOVSW:	case STR_MOVSD:
+		case STR_STOSB:	case STR_STOSW:	case STR_STOSD:
+			gen_releasereg(DREG(EAX));
+			gen_releasereg(DREG(ECX));
+			gen_releasereg(DREG(ESI));
+			gen_releasereg(DREG(EDI));
+			gen_call_function((void*)&dyn_string_bulk,"%Id%Id%Dd%Dd",op,decode.big_addr,si_base,di_base);
+			break;
+		default:
+			break;
+		}
 	}
 	/* Check what each string operation will be using */
 	switch (op) {
@@ -61,6 +61,10 @@
 #define DYN_HASH_SHIFT	(4)
 #define DYN_PAGE_HASH	(4096>>DYN_HASH_SHIFT)
 #define DYN_LINKS		(16)
+#define DYN_HOT_BLOCK	(4096)		// executions until a block is retranslated as a trace
+#define DYN_TRACE_OPCODES	(64)	// maximum number of instructions in a trace
+#define DYN_COLD_RUNS	(16)		// misses on a fresh page run by the normal core
+#define DYN_COLD_BURST	(32)		// cycles the normal core runs for such a miss
 
 
 //#define DYN_LOG 1 //Turn Logging on.
@@ -113,7 +117,17 @@ enum BlockReturn {
 #endif
 	BR_Iret,
 	BR_CallBack,
-	BR_SMCBlock
+	BR_SMCBlock,
+	BR_HotBlock
+};
+
+// floating point operations a backend can emit on the fpu registers itself
+// (see DRC_FPU_NATIVE_OPS)
+enum FpuOps {
+	FPUOP_ADD,
+	FPUOP_SUB,
+	FPUOP_MUL,
+	FPUOP_DIV
 };
 
 // identificator to signal self-modification of the currently executed block
@@ -149,6 +163,7 @@ static_assert(offsetof(core_dynrec_t, readdata) % sizeof(uint32_t) == 0,
               "core_dynrec.readdata must be double-word aligned");
 
 #include "dyn_cache.h"
+#include "string_bulk.h"
 
 #define X86			0x01
 #define X86_64		0x02
@@ -181,6 +196,7 @@ static_assert(offsetof(core_dynrec_t, readdata) % sizeof(uint32_t) == 0,
 #endif
 
 #include "core_dynrec/decoder.h"
+#include "core_dynrec/hot_pages.h"
 
 CacheBlock *LinkBlocks(BlockReturn ret)
 {
@@ -212,6 +228,10 @@ CacheBlock *LinkBlocks(BlockReturn ret)
 
 Bits CPU_Core_Dynrec_Run(void) {
 	for (;;) {
+		// no translated code is running here, the cache can be rebuilt
+		if (GCC_UNLIKELY(cache_growth.pending))
+			cache_grow();
+
 		// Determine the linear address of CS:EIP
 		PhysPt ip_point=SegPhys(cs)+reg_eip;
 #if C_HEAVY_DEBUG
@@ -233,9 +253,30 @@ Bits CPU_Core_Dynrec_Run(void) {
 		// find correct Dynamic Block to run
 		CacheBlock *block = chandler->FindCacheBlock(ip_point & 4095);
 		if (!block) {
+			// translate the blocks that were found in this page by earlier runs
+			if (GCC_UNLIKELY(hot_pages.enabled && !chandler->hot_checked) &&
+			    hot_pages_enter(chandler,ip_point)) continue;
 			// no block found, thus translate the instruction stream
 			// unless the instruction is known to be modified
 			if (!chandler->invalidation_map || (chandler->invalidation_map[ip_point&4095]<4)) {
+				if (chandler->cold_runs && (CPU_Cycles>0)) {
+					// lazy translation: code on a fresh page is run by the
+					// normal core first, so code that runs only a few times
+					// (loaders, initialization) never has to be translated
+					chandler->cold_runs--;
+					Bits burst=(CPU_Cycles<DYN_COLD_BURST) ? CPU_Cycles : DYN_COLD_BURST;
+					// the rest of the slice stays visible to the PIC, so
+					// events and irqs during the burst can still end it
+					CPU_CycleLeft+=CPU_Cycles-burst;
+					CPU_Cycles=burst;
+					Bits nc_retcode=CPU_Core_Normal_Run();
+					// cycles left over mean the burst stopped early, go on
+					// unless that was for a trap or a pending irq
+					if (!nc_retcode && (CPU_Cycles>0) && (cpudecoder==&CPU_Core_Dynrec_Run) &&
+					    !(GETFLAG(IF) && PIC_IRQCheck)) continue;
+					return nc_retcode;
+				}
+				if (hot_pages.enabled) hot_pages_add(chandler,ip_point);
 				// translate up to 32 instructions
 				block=CreateCacheBlock(chandler,ip_point,32);
 			} else {
@@ -325,6 +366,12 @@ run_block:
 			if (block) goto run_block;
 			break;
 
+		case BR_HotBlock:
+			// the block has been run often, drop it so it gets
+			// retranslated as a trace when execution continues
+			RequestTraceBlock(cache.block.running);
+			break;
+
 		default:
 			E_Exit("Invalid return code %d", ret);
 		}
@@ -359,7 +406,22 @@ void CPU_Core_Dynrec_Cache_Init(bool enable_cache) {
 	cache_init(enable_cache);
 }
 
+void CPU_Core_Dynrec_SetCacheSize(Bitu size_mb, bool growable) {
+	cache_set_size(size_mb, growable);
+}
+
+void CPU_Core_Dynrec_SetLazyTranslation(bool enabled) {
+	cache_cold_runs = enabled ? DYN_COLD_RUNS : 0;
+}
+
+void CPU_Core_Dynrec_SetHotPagesFile(const std::string &file) {
+	hot_pages.file=file;
+	hot_pages.enabled=!file.empty();
+	if (hot_pages.enabled) hot_pages_load();
+}
+
 void CPU_Core_Dynrec_Cache_Close(void) {
+	if (hot_pages.enabled) hot_pages_save();
 	cache_close();
 }
 
@@ -29,11 +29,36 @@
 	until either an unhandled instruction is found, the maximum
 	number of translated instructions is reached or some critical
 	instruction is encountered.
+
+	Every block counts its executions and returns BR_HotBlock once it
+	has been run DYN_HOT_BLOCK times. The core then drops the block and
+	requests a trace for its start address: the next translation follows
+	forward jumps inside the page and turns the closing branch of the hot
+	block into a side exit if it has never been taken, so frequently run
+	code paths end up in a single, longer block.
 */
 
+// drop a hot block and let the next translation at its start build a trace
+static void RequestTraceBlock(CacheBlock *block) {
+	CacheBlock *last=block->crossblock ? block->crossblock : block;
+	decode.trace.requested=true;
+	decode.trace.start_page=block->page.handler;
+	decode.trace.start_index=block->page.start;
+	decode.trace.end_page=last->page.handler;
+	decode.trace.end_index=last->page.end;
+	// only the not-taken link of the closing branch has been used
+	decode.trace.fallthrough=(block->link[0].to!=&link_blocks[0]) &&
+		(block->link[1].to==&link_blocks[1]);
+	block->Clear();
+}
+
 static CacheBlock *CreateCacheBlock(CodePageHandler *codepage, PhysPt start, Bitu max_opcodes)
 {
 	// initialize a load of variables
+	decode.trace.active=decode.trace.requested &&
+		(decode.trace.start_page==codepage) && (decode.trace.start_index==(start&4095));
+	decode.trace.requested=false;
+	if (decode.trace.active) max_opcodes=DYN_TRACE_OPCODES;
 	decode.code_start=start;
 	decode.code=start;
 	decode.page.code=codepage;
@@ -42,6 +67,10 @@ static CacheBlock *CreateCacheBlock(CodePageHandler *codepage, PhysPt start, Bit
 	decode.page.invmap=codepage->invalidation_map;
 	decode.page.first=start >> 12;
 	decode.active_block=decode.block=cache_openblock();
+#ifdef DRC_STORE_FORWARDING
+	// the block may reuse cache memory that was emitted right behind a store
+	gen_forget_store();
+#endif
 	decode.block->page.start=(Bit16u)decode.page.index;
 	codepage->AddCacheBlock(decode.block);
 
@@ -57,8 +86,20 @@ static CacheBlock *CreateCacheBlock(CodePageHandler *codepage, PhysPt start, Bit
 	save_info_dynrec[used_save_info_dynrec].type=cycle_check;
 	used_save_info_dynrec++;
 
+	if (!decode.trace.active) {
+		// count down the executions until the block is considered hot
+		decode.block->hot_count=DYN_HOT_BLOCK;
+		gen_sub_direct_word(&decode.block->hot_count,1,true);
+		gen_mov_word_to_reg(FC_RETOP,&decode.block->hot_count,true);
+		save_info_dynrec[used_save_info_dynrec].branch_pos=gen_create_branch_long_leqzero(FC_RETOP);
+		save_info_dynrec[used_save_info_dynrec].type=hot_check;
+		used_save_info_dynrec++;
+	}
+
 	decode.cycles=0;
 	while (max_opcodes--) {
+		// leave enough room in the block for the remaining code of a trace
+		if (decode.trace.active && (cache.pos-decode.block->cache.start>CACHE_MAXSIZE/2)) break;
 		// Init prefixes
 		decode.big_addr=cpu.code.big;
 		decode.big_op=cpu.code.big;
@@ -195,9 +236,12 @@ restart_prefix:
 				// short conditional jumps
 				case 0x80:case 0x81:case 0x82:case 0x83:case 0x84:case 0x85:case 0x86:case 0x87:	
 				case 0x88:case 0x89:case 0x8a:case 0x8b:case 0x8c:case 0x8d:case 0x8e:case 0x8f:	
-					dyn_branched_exit((BranchTypes)(dual_code&0xf),
-						decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw());
+				{
+					Bit32s eip_add=decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw();
+					if (dyn_trace_side_exit((BranchTypes)(dual_code&0xf),eip_add)) break;
+					dyn_branched_exit((BranchTypes)(dual_code&0xf),eip_add);
 					goto finish_block;
+				}
 
 				// conditional byte set instructions
 /*				case 0x90:case 0x91:case 0x92:case 0x93:case 0x94:case 0x95:case 0x96:case 0x97:	
@@ -298,8 +342,12 @@ restart_prefix:
 		// short conditional jumps
 		case 0x70:case 0x71:case 0x72:case 0x73:case 0x74:case 0x75:case 0x76:case 0x77:	
 		case 0x78:case 0x79:case 0x7a:case 0x7b:case 0x7c:case 0x7d:case 0x7e:case 0x7f:	
-			dyn_branched_exit((BranchTypes)(opcode&0xf),(Bit8s)decode_fetchb());	
+		{
+			Bit32s eip_add=(Bit8s)decode_fetchb();
+			if (dyn_trace_side_exit((BranchTypes)(opcode&0xf),eip_add)) break;
+			dyn_branched_exit((BranchTypes)(opcode&0xf),eip_add);
 			goto finish_block;
+		}
 
 		// 'op []/reg8,imm8'
 		case 0x80:
@@ -516,16 +564,24 @@ restart_prefix:
 			goto finish_block;
 		// 'jmp near imm16/32'
 		case 0xe9:
-			dyn_exit_link(decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw());
+		{
+			Bits eip_change=decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw();
+			if (dyn_trace_follow_jump(eip_change)) break;
+			dyn_exit_link(eip_change);
 			goto finish_block;
+		}
 		// 'jmp far'
 		case 0xea:
 			dyn_jmp_far_imm();
 			goto finish_block;
 		// 'jmp short imm8'
 		case 0xeb:
-			dyn_exit_link((Bit8s)decode_fetchb());
+		{
+			Bits eip_change=(Bit8s)decode_fetchb();
+			if (dyn_trace_follow_jump(eip_change)) break;
+			dyn_exit_link(eip_change);
 			goto finish_block;
+		}
 
 
 		// repeat prefixes
@@ -125,6 +125,17 @@ static struct DynDecode {
 		Bitu rm;
 		Bitu reg;
 	} modrm;
+
+	// retranslation of a hot block as a trace (see RequestTraceBlock)
+	struct {
+		bool requested;			// a trace should be built at start_page/start_index
+		bool active;			// the current block is translated as a trace
+		CodePageHandler *start_page;
+		Bitu start_index;
+		CodePageHandler *end_page;	// page containing the end of the hot block
+		Bitu end_index;			// index of the last byte of the hot block
+		bool fallthrough;		// the closing branch of the hot block was never taken
+	} trace;
 } decode;
 
 static bool MakeCodePage(Bitu lin_addr, CodePageHandler *&cph)
@@ -135,6 +146,11 @@ static bool MakeCodePage(Bitu lin_addr, CodePageHandler *&cph)
 	if (GCC_UNLIKELY(mem_readb_checked(lin_addr,&rdval))) return true;
 
 	PageHandler * handler=get_tlb_readhandler(lin_addr);
+	if (handler->flags & PFLAG_PREDECODED) {
+		// the normal core kept decoded instructions here, take the page over
+		CPU_Core_Normal_ReleasePage(handler);
+		handler=get_tlb_readhandler(lin_addr);
+	}
 	if (handler->flags & PFLAG_HASCODE) {
 		// this is a codepage handler, make sure it matches current code size
 		cph = (CodePageHandler *)handler;
@@ -172,6 +188,7 @@ static bool MakeCodePage(Bitu lin_addr, CodePageHandler *&cph)
 	}
 	// find a free CodePage
 	if (!cache.free_pages) {
+		cache_note_eviction();
 		if (cache.used_pages!=decode.page.code) cache.used_pages->ClearRelease();
 		else {
 			// try another page to avoid clearing our source-crosspage
@@ -605,7 +622,7 @@ static DRC_PTR_SIZE_IM INLINE gen_call_function_mm(void * func,Bitu op1,Bitu op2
 
 
 
-enum save_info_type {db_exception, cycle_check, string_break};
+enum save_info_type {db_exception, cycle_check, string_break, hot_check};
 
 
 // function that is called on exceptions
@@ -665,6 +682,10 @@ static void dyn_fill_blocks(void) {
 				gen_add_direct_word(&reg_eip,save_info_dynrec[sct].eip_change,decode.big_op);
 				dyn_return(BR_Cycles);
 				break;
+			case hot_check:
+				// block has been run often, let the core retranslate it as a trace
+				dyn_return(BR_HotBlock);
+				break;
 		}
 	}
 	used_save_info_dynrec=0;
@@ -1212,12 +1233,14 @@ static void gen_restore_reg(HostReg reg,HostReg dest_reg) {
 // they try to find out if a function can be replaced by another
 // one that does not generate any flags at all
 
+#define MF_FUNCTIONS_MAX 64
+
 static Bitu mf_functions_num=0;
 static struct {
 	Bit8u* pos;
 	void* fct_ptr;
 	Bitu ftype;
-} mf_functions[64];
+} mf_functions[MF_FUNCTIONS_MAX];
 
 static void InitFlagsOptimization(void) {
 	mf_functions_num=0;
@@ -1255,6 +1278,8 @@ static void InvalidateFlags(void* current_simple_function,Bitu flags_type) {
 // this function can be replaced by a simpler one as well
 static void InvalidateFlagsPartially(void* current_simple_function,Bitu flags_type) {
 #ifdef DRC_FLAGS_INVALIDATION
+	// queue full (long traces), keep the flag generating variant
+	if (GCC_UNLIKELY(mf_functions_num>=MF_FUNCTIONS_MAX)) return;
 	mf_functions[mf_functions_num].pos=cache.pos;
 	mf_functions[mf_functions_num].fct_ptr=current_simple_function;
 	mf_functions[mf_functions_num].ftype=flags_type;
@@ -1267,6 +1292,8 @@ static void InvalidateFlagsPartially(void* current_simple_function,Bitu flags_ty
 // this function can be replaced by a simpler one as well
 static void InvalidateFlagsPartially(void* current_simple_function,DRC_PTR_SIZE_IM cpos,Bitu flags_type) {
 #ifdef DRC_FLAGS_INVALIDATION
+	// queue full (long traces), keep the flag generating variant
+	if (GCC_UNLIKELY(mf_functions_num>=MF_FUNCTIONS_MAX)) return;
 	mf_functions[mf_functions_num].pos=(Bit8u*)cpos;
 	mf_functions[mf_functions_num].fct_ptr=current_simple_function;
 	mf_functions[mf_functions_num].ftype=flags_type;
@@ -632,20 +632,20 @@ static void dyn_grp2_eb(grp2_types type) {
 	switch (type) {
 	case grp2_1:
 		gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,1);
-		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg);
+		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg,true);
 		break;
 	case grp2_imm: {
 		Bit8u imm=decode_fetchb();
 		if (imm) {
 			gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,imm&0x1f);
-			dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg);
+			dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg,(imm&0x1f)!=0);
 		} else return;
 		}
 		break;
 	case grp2_cl:
 		MOV_REG_BYTE_TO_HOST_REG_LOW_CANUSEWORD(FC_OP2,DRC_REG_ECX,0);
 		gen_and_imm(FC_OP2,0x1f);
-		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg);
+		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg,false);
 		break;
 	}
 	if (decode.modrm.mod<3) {
@@ -668,27 +668,27 @@ static void dyn_grp2_ev(grp2_types type) {
 	switch (type) {
 	case grp2_1:
 		gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,1);
-		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,true);
 		break;
 	case grp2_imm: {
 		Bitu val;
 		if (decode_fetchb_imm(val)) {
 			gen_mov_byte_to_reg_low_canuseword(FC_OP2,(void*)val);
 			gen_and_imm(FC_OP2,0x1f);
-			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,false);
 			break;
 		}
 		Bit8u imm=(Bit8u)val;
 		if (imm) {
 			gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,imm&0x1f);
-			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,(imm&0x1f)!=0);
 		} else return;
 		}
 		break;
 	case grp2_cl:
 		MOV_REG_BYTE_TO_HOST_REG_LOW_CANUSEWORD(FC_OP2,DRC_REG_ECX,0);
 		gen_and_imm(FC_OP2,0x1f);
-		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,false);
 		break;
 	}
 	if (decode.modrm.mod<3) {
@@ -1120,6 +1120,41 @@ static void dyn_branched_exit(BranchTypes btype,Bit32s eip_add) {
 	dyn_closeblock();
 }
 
+// inside a trace continue with the target of a forward jump that stays
+// within the current page, the skipped bytes are masked out of the block
+static bool dyn_trace_follow_jump(Bits eip_change) {
+	if (!decode.trace.active || (eip_change<=0)) return false;
+	if (decode.page.index+(Bitu)eip_change>=4096) return false;
+	// a 16bit instruction pointer must not wrap around
+	if (!decode.big_op && (reg_eip+(decode.code-decode.code_start)+(Bitu)eip_change>0xffff)) return false;
+	for (Bits ct=0;ct<eip_change;ct++) {
+		decode_increase_wmapmask(1);
+		decode.page.index++;
+	}
+	decode.code+=eip_change;
+	return true;
+}
+
+// inside a trace the closing branch of the hot block, if it has never
+// been taken, becomes a side exit and translation continues after it
+static bool dyn_trace_side_exit(BranchTypes btype,Bit32s eip_add) {
+	if (!decode.trace.active || !decode.trace.fallthrough) return false;
+	if ((decode.page.code!=decode.trace.end_page) || (decode.page.index-1!=decode.trace.end_index)) return false;
+	Bitu eip_base=decode.code-decode.code_start;
+
+	// the flags are needed by the core if the branch is taken
+	AcquireFlags(FMASK_TEST);
+	dyn_branchflag_to_reg(btype);
+	DRC_PTR_SIZE_IM data=gen_create_branch_on_zero(FC_RETOP,true);
+
+	// Branch taken, leave the trace
+	gen_add_direct_word(&reg_eip,eip_base+eip_add,decode.big_op);
+	dyn_reduce_cycles();
+	dyn_return(BR_Normal);
+	gen_fill_branch(data);
+	return true;
+}
+
 /*
 static void dyn_set_byte_on_condition(BranchTypes btype) {
 	dyn_get_modrm();
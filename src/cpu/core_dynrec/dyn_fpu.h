@@ -53,6 +53,33 @@ static void FPU_FFREE(Bitu st) {
 #endif
 
 
+#if defined(DRC_FPU_NATIVE_OPS) && !C_FPU_X86
+// the backend can work on the doubles of the fpu registers directly
+#define DYN_FPU_NATIVE_OPS
+static_assert(sizeof(FPU_Reg) == sizeof(double), "fpu registers must be plain doubles");
+#endif
+
+// ST(FC_OP1) = ST(FC_OP1) op ST(FC_OP2) (reversed operands for fsubr/fdivr)
+static void dyn_fpu_op_regs(MAYBE_UNUSED FpuOps op,MAYBE_UNUSED bool reversed,
+                            MAYBE_UNUSED void* fct_ptr) {
+#ifdef DYN_FPU_NATIVE_OPS
+	gen_fpu_op_regs(op,reversed,FC_OP1,FC_OP2,(void*)fpu.regs);
+#else
+	gen_call_function_RR(fct_ptr,FC_OP1,FC_OP2);
+#endif
+}
+
+// ST(FC_OP1) = ST(FC_OP1) op memory operand (loaded into fpu.regs[8] before)
+static void dyn_fpu_op_ea(MAYBE_UNUSED FpuOps op,MAYBE_UNUSED bool reversed,
+                          MAYBE_UNUSED void* fct_ptr) {
+#ifdef DYN_FPU_NATIVE_OPS
+	gen_mov_dword_to_reg_imm(FC_OP2,8);
+	gen_fpu_op_regs(op,reversed,FC_OP1,FC_OP2,(void*)fpu.regs);
+#else
+	gen_call_function_R(fct_ptr,FC_OP1);
+#endif
+}
+
 static INLINE void dyn_fpu_top() {
 	gen_mov_word_to_reg(FC_OP2,(void*)(&TOP),true);
 	gen_add_imm(FC_OP2,decode.modrm.rm);
@@ -72,10 +99,10 @@ static void dyn_eatree() {
 	Bitu group = decode.modrm.reg&7; //It is already that, but compilers.
 	switch (group){
 	case 0x00:		// FADD ST,STi
-		gen_call_function_R((void*)&FPU_FADD_EA,FC_OP1);
+		dyn_fpu_op_ea(FPUOP_ADD,false,(void*)&FPU_FADD_EA);
 		break;
 	case 0x01:		// FMUL  ST,STi
-		gen_call_function_R((void*)&FPU_FMUL_EA,FC_OP1);
+		dyn_fpu_op_ea(FPUOP_MUL,false,(void*)&FPU_FMUL_EA);
 		break;
 	case 0x02:		// FCOM  STi
 		gen_call_function_R((void*)&FPU_FCOM_EA,FC_OP1);
@@ -85,16 +112,16 @@ static void dyn_eatree() {
 		gen_call_function_raw((void*)&FPU_FPOP);
 		break;
 	case 0x04:		// FSUB  ST,STi
-		gen_call_function_R((void*)&FPU_FSUB_EA,FC_OP1);
+		dyn_fpu_op_ea(FPUOP_SUB,false,(void*)&FPU_FSUB_EA);
 		break;	
 	case 0x05:		// FSUBR ST,STi
-		gen_call_function_R((void*)&FPU_FSUBR_EA,FC_OP1);
+		dyn_fpu_op_ea(FPUOP_SUB,true,(void*)&FPU_FSUBR_EA);
 		break;
 	case 0x06:		// FDIV  ST,STi
-		gen_call_function_R((void*)&FPU_FDIV_EA,FC_OP1);
+		dyn_fpu_op_ea(FPUOP_DIV,false,(void*)&FPU_FDIV_EA);
 		break;
 	case 0x07:		// FDIVR ST,STi
-		gen_call_function_R((void*)&FPU_FDIVR_EA,FC_OP1);
+		dyn_fpu_op_ea(FPUOP_DIV,true,(void*)&FPU_FDIVR_EA);
 		break;
 	default:
 		break;
@@ -108,10 +135,10 @@ static void dyn_fpu_esc0(){
 		dyn_fpu_top();
 		switch (decode.modrm.reg){
 		case 0x00:		//FADD ST,STi
-			gen_call_function_RR((void*)&FPU_FADD,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_ADD,false,(void*)&FPU_FADD);
 			break;
 		case 0x01:		// FMUL  ST,STi
-			gen_call_function_RR((void*)&FPU_FMUL,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_MUL,false,(void*)&FPU_FMUL);
 			break;
 		case 0x02:		// FCOM  STi
 			gen_call_function_RR((void*)&FPU_FCOM,FC_OP1,FC_OP2);
@@ -121,16 +148,16 @@ static void dyn_fpu_esc0(){
 			gen_call_function_raw((void*)&FPU_FPOP);
 			break;
 		case 0x04:		// FSUB  ST,STi
-			gen_call_function_RR((void*)&FPU_FSUB,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_SUB,false,(void*)&FPU_FSUB);
 			break;	
 		case 0x05:		// FSUBR ST,STi
-			gen_call_function_RR((void*)&FPU_FSUBR,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_SUB,true,(void*)&FPU_FSUBR);
 			break;
 		case 0x06:		// FDIV  ST,STi
-			gen_call_function_RR((void*)&FPU_FDIV,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_DIV,false,(void*)&FPU_FDIV);
 			break;
 		case 0x07:		// FDIVR ST,STi
-			gen_call_function_RR((void*)&FPU_FDIVR,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_DIV,true,(void*)&FPU_FDIVR);
 			break;
 		default:
 			break;
@@ -440,11 +467,11 @@ static void dyn_fpu_esc4(){
 		switch(decode.modrm.reg){
 		case 0x00:	/* FADD STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FADD,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_ADD,false,(void*)&FPU_FADD);
 			break;
 		case 0x01:	/* FMUL STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FMUL,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_MUL,false,(void*)&FPU_FMUL);
 			break;
 		case 0x02:  /* FCOM*/
 			dyn_fpu_top();
@@ -457,19 +484,19 @@ static void dyn_fpu_esc4(){
 			break;
 		case 0x04:  /* FSUBR STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FSUBR,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_SUB,true,(void*)&FPU_FSUBR);
 			break;
 		case 0x05:  /* FSUB  STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FSUB,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_SUB,false,(void*)&FPU_FSUB);
 			break;
 		case 0x06:  /* FDIVR STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FDIVR,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_DIV,true,(void*)&FPU_FDIVR);
 			break;
 		case 0x07:  /* FDIV STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FDIV,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_DIV,false,(void*)&FPU_FDIV);
 			break;
 		default:
 			break;
@@ -560,11 +587,11 @@ static void dyn_fpu_esc6(){
 		switch(decode.modrm.reg){
 		case 0x00:	/*FADDP STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FADD,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_ADD,false,(void*)&FPU_FADD);
 			break;
 		case 0x01:	/* FMULP STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FMUL,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_MUL,false,(void*)&FPU_FMUL);
 			break;
 		case 0x02:  /* FCOMP5*/
 			dyn_fpu_top();
@@ -584,19 +611,19 @@ static void dyn_fpu_esc6(){
 			break;
 		case 0x04:  /* FSUBRP STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FSUBR,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_SUB,true,(void*)&FPU_FSUBR);
 			break;
 		case 0x05:  /* FSUBP  STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FSUB,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_SUB,false,(void*)&FPU_FSUB);
 			break;
 		case 0x06:	/* FDIVRP STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FDIVR,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_DIV,true,(void*)&FPU_FDIVR);
 			break;
 		case 0x07:  /* FDIVP STi,ST*/
 			dyn_fpu_top_swapped();
-			gen_call_function_RR((void*)&FPU_FDIV,FC_OP1,FC_OP2);
+			dyn_fpu_op_regs(FPUOP_DIV,false,(void*)&FPU_FDIV);
 			break;
 		default:
 			break;
@@ -0,0 +1,182 @@
+/*
+ *  Copyright (C) 2002-2020  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define XXH_INLINE_ALL
+#include "../../libs/decoders/xxhash.h"
+
+/*
+	Translated code can't be kept between runs (see dyn_cache.h), so the
+	hot page list keeps the guest side instead: every physical page the
+	core translated code in, with an xxhash of its contents taken when the
+	core first entered it, and the start addresses of its blocks.
+
+	When a page of the list is entered again in a later run and its
+	contents hash the same, all of its known blocks are translated right
+	away instead of one by one as execution reaches them (and instead of
+	running the page in the normal core first with lazy translation).
+	Blocks are only translated ahead while paging is off, so the decoder
+	can't raise page faults, and only for the cpu mode they were found in.
+*/
+
+#define HOT_PAGES_MAGIC		0x50484244		// "DBHP"
+#define HOT_PAGES_VERSION	1
+
+// cpu mode a block was translated in, upper 4 bits of an entry
+#define HOT_MODE_BIG		0x1000
+#define HOT_MODE_PMODE		0x2000
+#define HOT_MODE_USER		0x4000
+#define HOT_MODE_VM			0x8000
+
+struct HotPage {
+	Bit64u hash;					// page contents when first entered
+	std::vector<Bit16u> entries;	// block start in the page | HOT_MODE_x
+};
+
+static struct {
+	bool enabled;
+	std::string file;
+	std::unordered_map<Bitu,HotPage> seen;	// pages entered in this run
+	std::unordered_map<Bitu,HotPage> known;	// from earlier runs, not entered yet
+} hot_pages;
+
+static Bit16u hot_pages_mode(void) {
+	Bit16u mode=0;
+	if (cpu.code.big) mode|=HOT_MODE_BIG;
+	if (cpu.pmode) mode|=HOT_MODE_PMODE;
+	if (cpu.cpl) mode|=HOT_MODE_USER;
+	if (reg_flags & FLAG_VM) mode|=HOT_MODE_VM;
+	return mode;
+}
+
+static void hot_pages_add_entry(HotPage &page,Bit16u entry) {
+	for (Bit16u known : page.entries) {
+		if (known==entry) return;
+	}
+	page.entries.push_back(entry);
+}
+
+// remember the start of a block that is going to be translated
+static void hot_pages_add(CodePageHandler *chandler,PhysPt ip_point) {
+	auto page=hot_pages.seen.find(chandler->GetPhysPage());
+	if (page==hot_pages.seen.end()) return;
+	hot_pages_add_entry(page->second,hot_pages_mode()|(Bit16u)(ip_point&4095));
+}
+
+// called the first time a code page misses a block, returns true if known
+// blocks of the page were translated (chandler may have been released then)
+static bool hot_pages_enter(CodePageHandler *chandler,PhysPt ip_point) {
+	chandler->hot_checked=true;
+	const Bitu phys_page=chandler->GetPhysPage();
+	const Bit64u hash=XXH64(chandler->GetHostReadPt(phys_page),4096,0);
+	HotPage &page=hot_pages.seen[phys_page];
+	if (page.hash!=hash) {
+		// new page or different code than before
+		page.hash=hash;
+		page.entries.clear();
+	}
+
+	auto known=hot_pages.known.find(phys_page);
+	if (known==hot_pages.known.end()) return false;
+	const HotPage old=std::move(known->second);
+	hot_pages.known.erase(known);
+	if (old.hash!=hash) return false;
+	for (Bit16u entry : old.entries) hot_pages_add_entry(page,entry);
+
+	if (paging.enabled || decode.trace.requested) return false;
+	const Bit16u mode=hot_pages_mode();
+	Bitu translated=0;
+	for (Bit16u entry : old.entries) {
+		if ((entry & 0xf000)!=mode) continue;
+		const Bitu start=entry&4095;
+		// the block has to start inside a 16bit code segment
+		if (!cpu.code.big && (reg_eip+start-(ip_point&4095))>0xffff) continue;
+		if (chandler->FindCacheBlock(start)) continue;
+		if (chandler->invalidation_map && (chandler->invalidation_map[start]>=4)) continue;
+		CreateCacheBlock(chandler,(ip_point&~4095)+start,32);
+		translated++;
+		// translating may evict pages, stop when it was this one
+		if (MEM_GetPageHandler(phys_page)!=chandler) break;
+	}
+	if (MEM_GetPageHandler(phys_page)==chandler) chandler->cold_runs=0;
+	return translated>0;
+}
+
+static void hot_pages_load(void) {
+	hot_pages.known.clear();
+	hot_pages.seen.clear();
+	FILE *f=fopen(hot_pages.file.c_str(),"rb");
+	if (!f) return;		// nothing saved yet
+	Bit32u header[3];	// magic, version, page count
+	if ((fread(header,sizeof(header),1,f)!=1) || (header[0]!=HOT_PAGES_MAGIC) ||
+		(header[1]!=HOT_PAGES_VERSION)) {
+		LOG_MSG("DYNREC:Ignoring hot page list %s",hot_pages.file.c_str());
+		fclose(f);
+		return;
+	}
+	for (Bit32u i=0;i<header[2];i++) {
+		Bit32u phys_page;
+		Bit64u hash;
+		Bit16u count;
+		if ((fread(&phys_page,sizeof(phys_page),1,f)!=1) ||
+			(fread(&hash,sizeof(hash),1,f)!=1) ||
+			(fread(&count,sizeof(count),1,f)!=1) || (count>4096)) break;
+		HotPage &page=hot_pages.known[phys_page];
+		page.hash=hash;
+		page.entries.resize(count);
+		if (count && (fread(page.entries.data(),sizeof(Bit16u),count,f)!=count)) {
+			LOG_MSG("DYNREC:Hot page list %s is truncated",hot_pages.file.c_str());
+			hot_pages.known.erase(phys_page);
+			break;
+		}
+	}
+	fclose(f);
+}
+
+static void hot_pages_write(FILE *f,Bitu phys_page,const HotPage &page) {
+	const Bit32u page32=(Bit32u)phys_page;
+	const Bit16u count=(Bit16u)page.entries.size();
+	fwrite(&page32,sizeof(page32),1,f);
+	fwrite(&page.hash,sizeof(page.hash),1,f);
+	fwrite(&count,sizeof(count),1,f);
+	fwrite(page.entries.data(),sizeof(Bit16u),count,f);
+}
+
+// pages of earlier runs that were not entered this time are kept
+static void hot_pages_save(void) {
+	FILE *f=fopen(hot_pages.file.c_str(),"wb");
+	if (!f) {
+		LOG_MSG("DYNREC:Can't write hot page list %s",hot_pages.file.c_str());
+		return;
+	}
+	Bit32u header[3]={HOT_PAGES_MAGIC,HOT_PAGES_VERSION,0};
+	for (const auto &page : hot_pages.seen) {
+		if (!page.second.entries.empty()) header[2]++;
+	}
+	header[2]+=(Bit32u)hot_pages.known.size();
+	fwrite(header,sizeof(header),1,f);
+	for (const auto &page : hot_pages.seen) {
+		if (!page.second.entries.empty()) hot_pages_write(f,page.first,page.second);
+	}
+	for (const auto &page : hot_pages.known) hot_pages_write(f,page.first,page.second);
+	fclose(f);
+}
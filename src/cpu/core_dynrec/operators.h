@@ -1111,7 +1111,14 @@ static Bit32u DRC_CALL_CONV dynrec_sar_dword_simple(Bit32u op1,Bit8u op2) {
 	else return op1 >> op2;
 }
 
-static void dyn_shift_byte_gencall(ShiftOps op) {
+// shifts by a known, nonzero count replace all condition flags, for
+// other counts the previous flags may still be needed
+static void InvalidateFlagsShift(void* current_simple_function,Bitu flags_type,bool count_known) {
+	if (count_known) InvalidateFlags(current_simple_function,flags_type);
+	else InvalidateFlagsPartially(current_simple_function,flags_type);
+}
+
+static void dyn_shift_byte_gencall(ShiftOps op,bool count_known) {
 	switch (op) {
 		case SHIFT_ROL:
 			InvalidateFlagsPartially((void*)&dynrec_rol_byte_simple,t_ROLb);
@@ -1131,22 +1138,22 @@ static void dyn_shift_byte_gencall(ShiftOps op) {
 			break;
 		case SHIFT_SHL:
 		case SHIFT_SAL:
-			InvalidateFlagsPartially((void*)&dynrec_shl_byte_simple,t_SHLb);
+			InvalidateFlagsShift((void*)&dynrec_shl_byte_simple,t_SHLb,count_known);
 			gen_call_function_raw((void*)&dynrec_shl_byte);
 			break;
 		case SHIFT_SHR:
-			InvalidateFlagsPartially((void*)&dynrec_shr_byte_simple,t_SHRb);
+			InvalidateFlagsShift((void*)&dynrec_shr_byte_simple,t_SHRb,count_known);
 			gen_call_function_raw((void*)&dynrec_shr_byte);
 			break;
 		case SHIFT_SAR:
-			InvalidateFlagsPartially((void*)&dynrec_sar_byte_simple,t_SARb);
+			InvalidateFlagsShift((void*)&dynrec_sar_byte_simple,t_SARb,count_known);
 			gen_call_function_raw((void*)&dynrec_sar_byte);
 			break;
 		default: IllegalOptionDynrec("dyn_shift_byte_gencall");
 	}
 }
 
-static void dyn_shift_word_gencall(ShiftOps op,bool dword) {
+static void dyn_shift_word_gencall(ShiftOps op,bool dword,bool count_known) {
 	if (dword) {
 		switch (op) {
 			case SHIFT_ROL:
@@ -1167,15 +1174,15 @@ static void dyn_shift_word_gencall(ShiftOps op,bool dword) {
 				break;
 			case SHIFT_SHL:
 			case SHIFT_SAL:
-				InvalidateFlagsPartially((void*)&dynrec_shl_dword_simple,t_SHLd);
+				InvalidateFlagsShift((void*)&dynrec_shl_dword_simple,t_SHLd,count_known);
 				gen_call_function_raw((void*)&dynrec_shl_dword);
 				break;
 			case SHIFT_SHR:
-				InvalidateFlagsPartially((void*)&dynrec_shr_dword_simple,t_SHRd);
+				InvalidateFlagsShift((void*)&dynrec_shr_dword_simple,t_SHRd,count_known);
 				gen_call_function_raw((void*)&dynrec_shr_dword);
 				break;
 			case SHIFT_SAR:
-				InvalidateFlagsPartially((void*)&dynrec_sar_dword_simple,t_SARd);
+				InvalidateFlagsShift((void*)&dynrec_sar_dword_simple,t_SARd,count_known);
 				gen_call_function_raw((void*)&dynrec_sar_dword);
 				break;
 			default: IllegalOptionDynrec("dyn_shift_dword_gencall");
@@ -1200,15 +1207,15 @@ static void dyn_shift_word_gencall(ShiftOps op,bool dword) {
 				break;
 			case SHIFT_SHL:
 			case SHIFT_SAL:
-				InvalidateFlagsPartially((void*)&dynrec_shl_word_simple,t_SHLw);
+				InvalidateFlagsShift((void*)&dynrec_shl_word_simple,t_SHLw,count_known);
 				gen_call_function_raw((void*)&dynrec_shl_word);
 				break;
 			case SHIFT_SHR:
-				InvalidateFlagsPartially((void*)&dynrec_shr_word_simple,t_SHRw);
+				InvalidateFlagsShift((void*)&dynrec_shr_word_simple,t_SHRw,count_known);
 				gen_call_function_raw((void*)&dynrec_shr_word);
 				break;
 			case SHIFT_SAR:
-				InvalidateFlagsPartially((void*)&dynrec_sar_word_simple,t_SARw);
+				InvalidateFlagsShift((void*)&dynrec_sar_word_simple,t_SARw,count_known);
 				gen_call_function_raw((void*)&dynrec_sar_word);
 				break;
 			default: IllegalOptionDynrec("dyn_shift_word_gencall");
@@ -1650,10 +1657,15 @@ static Bit16u DRC_CALL_CONV dynrec_movsb_word(Bit16u count,Bit16s add_index,Phys
 		count=(Bit16u)CPU_Cycles;
 		CPU_Cycles=0;
 	}
-	for (;count>0;count--) {
-		mem_writeb(di_base+reg_di,mem_readb(si_base+reg_si));
-		reg_si+=add_index;
-		reg_di+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkMovs(si_base,reg_si,di_base,reg_di,0xffff,add_index,count);
+		if (!run) {
+			mem_writeb(di_base+reg_di,mem_readb(si_base+reg_si));
+			run=1;
+		}
+		reg_si+=(Bit16u)(add_index*run);
+		reg_di+=(Bit16u)(add_index*run);
+		count-=(Bit16u)run;
 	}
 	return count_left;
 }
@@ -1668,10 +1680,15 @@ static Bit32u DRC_CALL_CONV dynrec_movsb_dword(Bit32u count,Bit32s add_index,Phy
 		count=CPU_Cycles;
 		CPU_Cycles=0;
 	}
-	for (;count>0;count--) {
-		mem_writeb(di_base+reg_edi,mem_readb(si_base+reg_esi));
-		reg_esi+=add_index;
-		reg_edi+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkMovs(si_base,reg_esi,di_base,reg_edi,0xffffffff,add_index,count);
+		if (!run) {
+			mem_writeb(di_base+reg_edi,mem_readb(si_base+reg_esi));
+			run=1;
+		}
+		reg_esi+=(Bit32u)(add_index*run);
+		reg_edi+=(Bit32u)(add_index*run);
+		count-=(Bit32u)run;
 	}
 	return count_left;
 }
@@ -1687,10 +1704,15 @@ static Bit16u DRC_CALL_CONV dynrec_movsw_word(Bit16u count,Bit16s add_index,Phys
 		CPU_Cycles=0;
 	}
 	add_index<<=1;
-	for (;count>0;count--) {
-		mem_writew(di_base+reg_di,mem_readw(si_base+reg_si));
-		reg_si+=add_index;
-		reg_di+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkMovs(si_base,reg_si,di_base,reg_di,0xffff,add_index,count);
+		if (!run) {
+			mem_writew(di_base+reg_di,mem_readw(si_base+reg_si));
+			run=1;
+		}
+		reg_si+=(Bit16u)(add_index*run);
+		reg_di+=(Bit16u)(add_index*run);
+		count-=(Bit16u)run;
 	}
 	return count_left;
 }
@@ -1706,10 +1728,15 @@ static Bit32u DRC_CALL_CONV dynrec_movsw_dword(Bit32u count,Bit32s add_index,Phy
 		CPU_Cycles=0;
 	}
 	add_index<<=1;
-	for (;count>0;count--) {
-		mem_writew(di_base+reg_edi,mem_readw(si_base+reg_esi));
-		reg_esi+=add_index;
-		reg_edi+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkMovs(si_base,reg_esi,di_base,reg_edi,0xffffffff,add_index,count);
+		if (!run) {
+			mem_writew(di_base+reg_edi,mem_readw(si_base+reg_esi));
+			run=1;
+		}
+		reg_esi+=(Bit32u)(add_index*run);
+		reg_edi+=(Bit32u)(add_index*run);
+		count-=(Bit32u)run;
 	}
 	return count_left;
 }
@@ -1725,10 +1752,15 @@ static Bit16u DRC_CALL_CONV dynrec_movsd_word(Bit16u count,Bit16s add_index,Phys
 		CPU_Cycles=0;
 	}
 	add_index<<=2;
-	for (;count>0;count--) {
-		mem_writed(di_base+reg_di,mem_readd(si_base+reg_si));
-		reg_si+=add_index;
-		reg_di+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkMovs(si_base,reg_si,di_base,reg_di,0xffff,add_index,count);
+		if (!run) {
+			mem_writed(di_base+reg_di,mem_readd(si_base+reg_si));
+			run=1;
+		}
+		reg_si+=(Bit16u)(add_index*run);
+		reg_di+=(Bit16u)(add_index*run);
+		count-=(Bit16u)run;
 	}
 	return count_left;
 }
@@ -1744,10 +1776,15 @@ static Bit32u DRC_CALL_CONV dynrec_movsd_dword(Bit32u count,Bit32s add_index,Phy
 		CPU_Cycles=0;
 	}
 	add_index<<=2;
-	for (;count>0;count--) {
-		mem_writed(di_base+reg_edi,mem_readd(si_base+reg_esi));
-		reg_esi+=add_index;
-		reg_edi+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkMovs(si_base,reg_esi,di_base,reg_edi,0xffffffff,add_index,count);
+		if (!run) {
+			mem_writed(di_base+reg_edi,mem_readd(si_base+reg_esi));
+			run=1;
+		}
+		reg_esi+=(Bit32u)(add_index*run);
+		reg_edi+=(Bit32u)(add_index*run);
+		count-=(Bit32u)run;
 	}
 	return count_left;
 }
@@ -1870,9 +1907,14 @@ static Bit16u DRC_CALL_CONV dynrec_stosb_word(Bit16u count,Bit16s add_index,Phys
 		count=(Bit16u)CPU_Cycles;
 		CPU_Cycles=0;
 	}
-	for (;count>0;count--) {
-		mem_writeb(di_base+reg_di,reg_al);
-		reg_di+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkStos(di_base,reg_di,0xffff,add_index,count,reg_al);
+		if (!run) {
+			mem_writeb(di_base+reg_di,reg_al);
+			run=1;
+		}
+		reg_di+=(Bit16u)(add_index*run);
+		count-=(Bit16u)run;
 	}
 	return count_left;
 }
@@ -1887,9 +1929,14 @@ static Bit32u DRC_CALL_CONV dynrec_stosb_dword(Bit32u count,Bit32s add_index,Phy
 		count=CPU_Cycles;
 		CPU_Cycles=0;
 	}
-	for (;count>0;count--) {
-		mem_writeb(di_base+reg_edi,reg_al);
-		reg_edi+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkStos(di_base,reg_edi,0xffffffff,add_index,count,reg_al);
+		if (!run) {
+			mem_writeb(di_base+reg_edi,reg_al);
+			run=1;
+		}
+		reg_edi+=(Bit32u)(add_index*run);
+		count-=(Bit32u)run;
 	}
 	return count_left;
 }
@@ -1905,9 +1952,14 @@ static Bit16u DRC_CALL_CONV dynrec_stosw_word(Bit16u count,Bit16s add_index,Phys
 		CPU_Cycles=0;
 	}
 	add_index<<=1;
-	for (;count>0;count--) {
-		mem_writew(di_base+reg_di,reg_ax);
-		reg_di+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkStos(di_base,reg_di,0xffff,add_index,count,reg_ax);
+		if (!run) {
+			mem_writew(di_base+reg_di,reg_ax);
+			run=1;
+		}
+		reg_di+=(Bit16u)(add_index*run);
+		count-=(Bit16u)run;
 	}
 	return count_left;
 }
@@ -1923,9 +1975,14 @@ static Bit32u DRC_CALL_CONV dynrec_stosw_dword(Bit32u count,Bit32s add_index,Phy
 		CPU_Cycles=0;
 	}
 	add_index<<=1;
-	for (;count>0;count--) {
-		mem_writew(di_base+reg_edi,reg_ax);
-		reg_edi+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkStos(di_base,reg_edi,0xffffffff,add_index,count,reg_ax);
+		if (!run) {
+			mem_writew(di_base+reg_edi,reg_ax);
+			run=1;
+		}
+		reg_edi+=(Bit32u)(add_index*run);
+		count-=(Bit32u)run;
 	}
 	return count_left;
 }
@@ -1941,9 +1998,14 @@ static Bit16u DRC_CALL_CONV dynrec_stosd_word(Bit16u count,Bit16s add_index,Phys
 		CPU_Cycles=0;
 	}
 	add_index<<=2;
-	for (;count>0;count--) {
-		mem_writed(di_base+reg_di,reg_eax);
-		reg_di+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkStos(di_base,reg_di,0xffff,add_index,count,reg_eax);
+		if (!run) {
+			mem_writed(di_base+reg_di,reg_eax);
+			run=1;
+		}
+		reg_di+=(Bit16u)(add_index*run);
+		count-=(Bit16u)run;
 	}
 	return count_left;
 }
@@ -1959,9 +2021,14 @@ static Bit32u DRC_CALL_CONV dynrec_stosd_dword(Bit32u count,Bit32s add_index,Phy
 		CPU_Cycles=0;
 	}
 	add_index<<=2;
-	for (;count>0;count--) {
-		mem_writed(di_base+reg_edi,reg_eax);
-		reg_edi+=add_index;
+	while (count>0) {
+		Bitu run=StringBulkStos(di_base,reg_edi,0xffffffff,add_index,count,reg_eax);
+		if (!run) {
+			mem_writed(di_base+reg_edi,reg_eax);
+			run=1;
+		}
+		reg_edi+=(Bit32u)(add_index*run);
+		count-=(Bit32u)run;
 	}
 	return count_left;
 }
@@ -40,6 +40,12 @@
 #define DRC_USE_REGS_ADDR
 // use FC_SEGS_ADDR to hold the address of "Segs" and to access it using FC_SEGS_ADDR
 #define DRC_USE_SEGS_ADDR
+// basic arithmetic on the fpu registers can be done in generated code (gen_fpu_op_regs)
+#define DRC_FPU_NATIVE_OPS
+
+// a load that directly follows a store of the same location reuses the register
+// (gen_forget_store has to be called where emission starts at a new position)
+#define DRC_STORE_FORWARDING
 
 // register mapping
 typedef Bit8u HostReg;
@@ -337,6 +343,20 @@ typedef Bit8u HostReg;
 // ubfm dst, src, #rimm, #simm		@	0 <= rimm < 64, 0 <= simm < 64
 #define UBFM64(dst, src, rimm, simm) (0xd3400000 + (dst) + ((src) << 5) + ((rimm) << 16) + ((simm) << 10) )
 
+// floating point
+// ldr dreg, [addr1, addr2, uxtw #3]
+#define LDR_D_REG_UXTW3(dreg, addr1, addr2) (0xfc605800 + (dreg) + ((addr1) << 5) + ((addr2) << 16) )
+// str dreg, [addr1, addr2, uxtw #3]
+#define STR_D_REG_UXTW3(dreg, addr1, addr2) (0xfc205800 + (dreg) + ((addr1) << 5) + ((addr2) << 16) )
+// fadd ddst, dsrc1, dsrc2
+#define FADD_D(dst, src1, src2) (0x1e602800 + (dst) + ((src1) << 5) + ((src2) << 16) )
+// fsub ddst, dsrc1, dsrc2
+#define FSUB_D(dst, src1, src2) (0x1e603800 + (dst) + ((src1) << 5) + ((src2) << 16) )
+// fmul ddst, dsrc1, dsrc2
+#define FMUL_D(dst, src1, src2) (0x1e600800 + (dst) + ((src1) << 5) + ((src2) << 16) )
+// fdiv ddst, dsrc1, dsrc2
+#define FDIV_D(dst, src1, src2) (0x1e601800 + (dst) + ((src1) << 5) + ((src2) << 16) )
+
 
 // move a full register from reg_src to reg_dst
 static void gen_mov_regs(HostReg reg_dst,HostReg reg_src) {
@@ -449,6 +469,40 @@ static void gen_mov_qword_to_reg_imm(HostReg dest_reg,Bit64u imm) {
 	}
 }
 
+// the last register stored into memory, a load of the same location that
+// directly follows the store (no code and no branch target in between)
+// is replaced by a register move, this keeps a guest register that is
+// written by one instruction and read by the next in the host register
+static struct {
+	Bit8u * pos;	// cache position behind the store
+	void * data;
+	HostReg reg;
+	bool dword;
+} last_store;
+
+static void gen_remember_store(HostReg src_reg,void* dest,bool dword) {
+	last_store.pos=cache.pos;
+	last_store.data=dest;
+	last_store.reg=src_reg;
+	last_store.dword=dword;
+}
+
+// code at the current position can be reached from elsewhere (branch target
+// or start of a block), so the registers don't hold the last store anymore
+static void gen_forget_store(void) {
+	last_store.pos=NULL;
+}
+
+static bool gen_forward_store(HostReg dest_reg,void* data,bool dword) {
+	if ((last_store.pos!=cache.pos) || (last_store.data!=data) || (last_store.dword!=dword)) return false;
+	if (dword) {
+		cache_addd( MOV_REG_LSL_IMM(dest_reg, last_store.reg, 0) );     // mov dest_reg, src_reg
+	} else {
+		cache_addd( UXTH(dest_reg, last_store.reg) );                   // uxth dest_reg, src_reg
+	}
+	return true;
+}
+
 // helper function for gen_mov_word_to_reg
 static void gen_mov_word_to_reg_helper(HostReg dest_reg,void* data,bool dword,HostReg data_reg) {
 	if (dword) {
@@ -461,6 +515,7 @@ static void gen_mov_word_to_reg_helper(HostReg dest_reg,void* data,bool dword,Ho
 // move a 32bit (dword==true) or 16bit (dword==false) value from memory into dest_reg
 // 16bit moves may destroy the upper 16bit of the destination register
 static void gen_mov_word_to_reg(HostReg dest_reg,void* data,bool dword) {
+	if (gen_forward_store(dest_reg, data, dword)) return;
 	if (!gen_mov_memval_to_reg(dest_reg, data, (dword)?4:2)) {
 		gen_mov_qword_to_reg_imm(temp1, (Bit64u)data);
 		gen_mov_word_to_reg_helper(dest_reg, data, dword, temp1);
@@ -540,6 +595,7 @@ static void gen_mov_word_from_reg(HostReg src_reg,void* dest,bool dword) {
 		gen_mov_qword_to_reg_imm(temp1, (Bit64u)dest);
 		gen_mov_word_from_reg_helper(src_reg, dest, dword, temp1);
 	}
+	gen_remember_store(src_reg, dest, dword);
 }
 
 // move an 8bit value from memory into dest_reg
@@ -836,6 +892,8 @@ static DRC_PTR_SIZE_IM gen_create_branch_on_nonzero(HostReg reg,bool dword) {
 
 // calculate relative offset and fill it into the location pointed to by data
 static void INLINE gen_fill_branch(DRC_PTR_SIZE_IM data) {
+	// the current position is a branch target now
+	gen_forget_store();
 #if C_DEBUG
 	Bits len=(Bit64u)cache.pos-data;
 	if (len<0) len=-len;
@@ -868,6 +926,7 @@ static DRC_PTR_SIZE_IM gen_create_branch_long_leqzero(HostReg reg) {
 
 // calculate long relative offset and fill it into the location pointed to by data
 static void INLINE gen_fill_branch_long(DRC_PTR_SIZE_IM data) {
+	gen_forget_store();
 	// optimize for shorter branches ?
 	*(Bit32u*)data=( (*(Bit32u*)data) & 0xfc000000 ) | ( ( ((Bit64u)cache.pos - data) >> 2 ) & 0x03ffffff );
 }
@@ -1161,22 +1220,41 @@ static void gen_add_seg32_to_reg(HostReg reg,Bitu index) {
 
 #endif
 
+// regs[st] = regs[st] op regs[other] (reversed==false) or
+// regs[st] = regs[other] op regs[st] (reversed==true) on an array of doubles,
+// st and other hold the register indices
+static void gen_fpu_op_regs(FpuOps op,bool reversed,HostReg st,HostReg other,void* regs) {
+	gen_mov_qword_to_reg_imm(temp1, (Bit64u)regs);
+	cache_addd( LDR_D_REG_UXTW3(0, temp1, reversed ? other : st) );     // ldr d0, [temp1, first, uxtw #3]
+	cache_addd( LDR_D_REG_UXTW3(1, temp1, reversed ? st : other) );     // ldr d1, [temp1, second, uxtw #3]
+	switch (op) {
+		case FPUOP_ADD: cache_addd( FADD_D(0, 0, 1) ); break;    // fadd d0, d0, d1
+		case FPUOP_SUB: cache_addd( FSUB_D(0, 0, 1) ); break;    // fsub d0, d0, d1
+		case FPUOP_MUL: cache_addd( FMUL_D(0, 0, 1) ); break;    // fmul d0, d0, d1
+		case FPUOP_DIV: cache_addd( FDIV_D(0, 0, 1) ); break;    // fdiv d0, d0, d1
+	}
+	cache_addd( STR_D_REG_UXTW3(0, temp1, st) );                        // str d0, [temp1, st, uxtw #3]
+}
+
 #ifdef DRC_USE_REGS_ADDR
 
 // mov 16bit value from cpu_regs[index] into dest_reg using FC_REGS_ADDR (index modulo 2 must be zero)
 // 16bit moves may destroy the upper 16bit of the destination register
 static void gen_mov_regval16_to_reg(HostReg dest_reg,Bitu index) {
+	if (gen_forward_store(dest_reg, (Bit8u*)&cpu_regs + index, false)) return;
 	cache_addd( LDRH_IMM(dest_reg, FC_REGS_ADDR, index) );      // ldrh dest_reg, [FC_REGS_ADDR, #index]
 }
 
 // mov 32bit value from cpu_regs[index] into dest_reg using FC_REGS_ADDR (index modulo 4 must be zero)
 static void gen_mov_regval32_to_reg(HostReg dest_reg,Bitu index) {
+	if (gen_forward_store(dest_reg, (Bit8u*)&cpu_regs + index, true)) return;
 	cache_addd( LDR_IMM(dest_reg, FC_REGS_ADDR, index) );      // ldr dest_reg, [FC_REGS_ADDR, #index]
 }
 
 // move a 32bit (dword==true) or 16bit (dword==false) value from cpu_regs[index] into dest_reg using FC_REGS_ADDR (if dword==true index modulo 4 must be zero) (if dword==false index modulo 2 must be zero)
 // 16bit moves may destroy the upper 16bit of the destination register
 static void gen_mov_regword_to_reg(HostReg dest_reg,Bitu index,bool dword) {
+	if (gen_forward_store(dest_reg, (Bit8u*)&cpu_regs + index, dword)) return;
 	if (dword) {
 		cache_addd( LDR_IMM(dest_reg, FC_REGS_ADDR, index) );      // ldr dest_reg, [FC_REGS_ADDR, #index]
 	} else {
@@ -1211,11 +1289,13 @@ static void gen_add_regval32_to_reg(HostReg reg,Bitu index) {
 // move 16bit of register into cpu_regs[index] using FC_REGS_ADDR (index modulo 2 must be zero)
 static void gen_mov_regval16_from_reg(HostReg src_reg,Bitu index) {
 	cache_addd( STRH_IMM(src_reg, FC_REGS_ADDR, index) );      // strh src_reg, [FC_REGS_ADDR, #index]
+	gen_remember_store(src_reg, (Bit8u*)&cpu_regs + index, false);
 }
 
 // move 32bit of register into cpu_regs[index] using FC_REGS_ADDR (index modulo 4 must be zero)
 static void gen_mov_regval32_from_reg(HostReg src_reg,Bitu index) {
 	cache_addd( STR_IMM(src_reg, FC_REGS_ADDR, index) );      // str src_reg, [FC_REGS_ADDR, #index]
+	gen_remember_store(src_reg, (Bit8u*)&cpu_regs + index, true);
 }
 
 // move 32bit (dword==true) or 16bit (dword==false) of a register into cpu_regs[index] using FC_REGS_ADDR (if dword==true index modulo 4 must be zero) (if dword==false index modulo 2 must be zero)
@@ -1225,6 +1305,7 @@ static void gen_mov_regword_from_reg(HostReg src_reg,Bitu index,bool dword) {
 	} else {
 		cache_addd( STRH_IMM(src_reg, FC_REGS_ADDR, index) );      // strh src_reg, [FC_REGS_ADDR, #index]
 	}
+	gen_remember_store(src_reg, (Bit8u*)&cpu_regs + index, dword);
 }
 
 // move the lowest 8bit of a register into cpu_regs[index] using FC_REGS_ADDR
@@ -29,6 +29,13 @@
 // try to replace _simple functions by code
 #define DRC_FLAGS_INVALIDATION_DCODE
 
+// basic arithmetic on the fpu registers can be done in generated code (gen_fpu_op_regs)
+#define DRC_FPU_NATIVE_OPS
+
+// a load that directly follows a store of the same location reuses the register
+// (gen_forget_store has to be called where emission starts at a new position)
+#define DRC_STORE_FORWARDING
+
 // type with the same size as a pointer
 #define DRC_PTR_SIZE_IM Bit64u
 
@@ -170,9 +177,42 @@ static INLINE void gen_memaddr(Bitu modreg,void* data,Bitu off,Bitu imm,Bit8u op
 	}
 }
 
+// the last register stored into memory, a load of the same location that
+// directly follows the store (no code and no branch target in between)
+// is replaced by a register move, this keeps a guest register that is
+// written by one instruction and read by the next in the host register
+static struct {
+	Bit8u * pos;	// cache position behind the store
+	void * data;
+	HostReg reg;
+	bool dword;
+} last_store;
+
+static void gen_remember_store(HostReg src_reg,void* dest,bool dword) {
+	last_store.pos=cache.pos;
+	last_store.data=dest;
+	last_store.reg=src_reg;
+	last_store.dword=dword;
+}
+
+// code at the current position can be reached from elsewhere (branch target
+// or start of a block), so the registers don't hold the last store anymore
+static void gen_forget_store(void) {
+	last_store.pos=NULL;
+}
+
+static bool gen_forward_store(HostReg dest_reg,void* data,bool dword) {
+	if ((last_store.pos!=cache.pos) || (last_store.data!=data) || (last_store.dword!=dword)) return false;
+	if (dword) cache_addb(0x8b);		// mov dest_reg,src_reg (clears the upper 32bit)
+	else cache_addw(0xb70f);			// movzx dest_reg,src_reg
+	cache_addb(0xc0+(dest_reg<<3)+last_store.reg);
+	return true;
+}
+
 // move a 32bit (dword==true) or 16bit (dword==false) value from memory into dest_reg
 // 16bit moves may destroy the upper 16bit of the destination register
 static void gen_mov_word_to_reg(HostReg dest_reg,void* data,bool dword,Bit8u prefix=0) {
+	if (!prefix && gen_forward_store(dest_reg,data,dword)) return;
 	if (!dword) gen_reg_memaddr(dest_reg,data,0xb7,0x0f);	// movzx reg,[data] - zero extend data, fixes LLVM compile where the called function does not extend the parameters
 	else gen_reg_memaddr(dest_reg,data,0x8b,prefix);	// mov reg,[data]
 } 
@@ -204,6 +244,7 @@ static void gen_mov_reg_qword(HostReg dest_reg,Bit64u imm) {
 // move 32bit (dword==true) or 16bit (dword==false) of a register into memory
 static void gen_mov_word_from_reg(HostReg src_reg,void* dest,bool dword,Bit8u prefix=0) {
 	gen_reg_memaddr(src_reg,dest,0x89,(dword?prefix:0x66));		// mov [data],reg
+	if (!dword || !prefix) gen_remember_store(src_reg,dest,dword);
 }
 
 // move an 8bit value from memory into dest_reg
@@ -564,6 +605,8 @@ static Bit64u gen_create_branch_on_nonzero(HostReg reg,bool dword) {
 
 // calculate relative offset and fill it into the location pointed to by data
 static void gen_fill_branch(DRC_PTR_SIZE_IM data) {
+	// the current position is a branch target now
+	gen_forget_store();
 #if C_DEBUG
 	Bit64s len=(Bit64u)cache.pos-data;
 	if (len<0) len=-len;
@@ -598,6 +641,7 @@ static Bit64u gen_create_branch_long_leqzero(HostReg reg) {
 
 // calculate long relative offset and fill it into the location pointed to by data
 static void gen_fill_branch_long(Bit64u data) {
+	gen_forget_store();
 	*(Bit32u*)data=(Bit32u)((Bit64u)cache.pos-data-4);
 }
 
@@ -616,6 +660,28 @@ static void gen_return_function(void) {
 	cache_addw(0xE5FF); // jmp rbp
 }
 
+#if !C_FPU_X86
+// regs[st] = regs[st] op regs[other] (reversed==false) or
+// regs[st] = regs[other] op regs[st] (reversed==true) on an array of doubles,
+// st and other hold the register indices
+static void gen_fpu_op_regs(FpuOps op,bool reversed,HostReg st,HostReg other,void* regs) {
+	gen_mov_reg_qword(HOST_EAX,(Bit64u)regs);
+	cache_addd(0x04100ff2);		// movsd xmm0,[rax+first*8]
+	cache_addb(0xc0+((reversed ? other : st)<<3));
+	cache_addw(0x0ff2);
+	switch (op) {
+		case FPUOP_ADD: cache_addb(0x58); break;	// addsd xmm0,[rax+second*8]
+		case FPUOP_SUB: cache_addb(0x5c); break;	// subsd xmm0,[rax+second*8]
+		case FPUOP_MUL: cache_addb(0x59); break;	// mulsd xmm0,[rax+second*8]
+		case FPUOP_DIV: cache_addb(0x5e); break;	// divsd xmm0,[rax+second*8]
+	}
+	cache_addb(0x04);
+	cache_addb(0xc0+((reversed ? st : other)<<3));
+	cache_addd(0x04110ff2);		// movsd [rax+st*8],xmm0
+	cache_addb(0xc0+(st<<3));
+}
+#endif
+
 #ifdef DRC_FLAGS_INVALIDATION
 // called when a call to a function can be replaced by a
 // call to a simpler function
@@ -27,6 +27,7 @@
 #include "pic.h"
 #include "fpu.h"
 #include "paging.h"
+#include "string_bulk.h"
 
 #if C_DEBUG
 #include "debug.h"
@@ -58,6 +59,14 @@ extern Bitu cycle_count;
 #define CPU_PIC_CHECK 1
 #define CPU_TRAP_CHECK 1
 
+#if C_CORE_THREADED
+#define CPU_THREADED_DISPATCH 1				//Jump to handlers through opcode_targets
+#endif
+
+#if C_CORE_PREDECODE
+#define CPU_PREDECODE 1						//Keep decoded instructions of RAM pages
+#endif
+
 #define CPU_TRAP_DECODER	CPU_Core_Normal_Trap_Run
 
 #define OPCODE_NONE			0x000
@@ -70,10 +79,17 @@ extern Bitu cycle_count;
 #define TEST_PREFIX_ADDR	(core.prefixes & PREFIX_ADDR)
 #define TEST_PREFIX_REP		(core.prefixes & PREFIX_REP)
 
+#if CPU_PREDECODE
+#define PREDECODE_SEG(_SEG)	core.pd_seg=_SEG;
+#else
+#define PREDECODE_SEG(_SEG)
+#endif
+
 #define DO_PREFIX_SEG(_SEG)					\
 	BaseDS=SegBase(_SEG);					\
 	BaseSS=SegBase(_SEG);					\
 	core.base_val_ds=_SEG;					\
+	PREDECODE_SEG(_SEG)						\
 	goto restart_opcode;
 
 #define DO_PREFIX_ADDR()								\
@@ -89,6 +105,11 @@ extern Bitu cycle_count;
 
 typedef PhysPt (*GetEAHandler)(void);
 
+#if CPU_PREDECODE
+struct PredecodedOp;
+class PredecodePageHandler;
+#endif
+
 static const Bit32u AddrMaskTable[2]={0x0000ffff,0xffffffff};
 
 static struct {
@@ -99,6 +120,18 @@ static struct {
 	bool rep_zero;
 	Bitu prefixes;
 	GetEAHandler * ea_table;
+	PhysPt fetch_page;
+	HostPt fetch_host;
+#if CPU_PREDECODE
+	PredecodedOp * op;					// record of the current instruction
+	PredecodePageHandler * pd_page;		// records of the page cseip is in
+	PageHandler * pd_handler;			// pd_page was looked up for these
+	Bitu pd_lin;
+	bool pd_big;
+	PredecodePageHandler * pd_fill;		// current instruction gets a record
+	PhysPt pd_start;
+	Bit8u pd_seg;
+#endif
 } core;
 
 #define GETIP		(core.cseip-SegBase(cs))
@@ -109,19 +142,53 @@ static struct {
 #define BaseDS		core.base_ds
 #define BaseSS		core.base_ss
 
+/* Opcode and operand bytes are read through the TLB entry of the page the
+   instruction starts in, which is looked up once per instruction instead of
+   once per fetch. Fetches leaving that page take the regular path. */
+static INLINE void SetFetchPage() {
+	HostPt tlb_addr=get_tlb_read(core.cseip);
+	core.fetch_host=tlb_addr;
+	/* Without a direct read pointer park fetch_page 2GB away from cseip,
+	   the range checks below can then never succeed */
+	core.fetch_page=tlb_addr ? (core.cseip&~0xfff) : (core.cseip^0x80000000);
+}
+
+#if CPU_PREDECODE
+static PredecodePageHandler * PD_GetPage(PhysPt lin_addr,PageHandler * handler);
+
+/* The records are looked up again whenever the page, its handler or the
+   code size change, releasing a page clears the TLB */
+static INLINE void SetPredecodePage() {
+	PageHandler * handler=get_tlb_readhandler(core.cseip);
+	if (GCC_UNLIKELY(handler!=core.pd_handler || (core.cseip>>12)!=core.pd_lin ||
+		cpu.code.big!=core.pd_big)) {
+		core.pd_handler=handler;
+		core.pd_lin=core.cseip>>12;
+		core.pd_big=cpu.code.big;
+		core.pd_page=core.fetch_host ? PD_GetPage(core.cseip,handler) : nullptr;
+	}
+}
+#endif
+
 static INLINE Bit8u Fetchb() {
-	Bit8u temp=LoadMb(core.cseip);
+	Bit8u temp;
+	if (GCC_LIKELY((PhysPt)(core.cseip-core.fetch_page)<=0xfff)) temp=host_readb(core.fetch_host+core.cseip);
+	else temp=LoadMb(core.cseip);
 	core.cseip+=1;
 	return temp;
 }
 
 static INLINE Bit16u Fetchw() {
-	Bit16u temp=LoadMw(core.cseip);
+	Bit16u temp;
+	if (GCC_LIKELY((PhysPt)(core.cseip-core.fetch_page)<=0xffe)) temp=host_readw(core.fetch_host+core.cseip);
+	else temp=LoadMw(core.cseip);
 	core.cseip+=2;
 	return temp;
 }
 static INLINE Bit32u Fetchd() {
-	Bit32u temp=LoadMd(core.cseip);
+	Bit32u temp;
+	if (GCC_LIKELY((PhysPt)(core.cseip-core.fetch_page)<=0xffc)) temp=host_readd(core.fetch_host+core.cseip);
+	else temp=LoadMd(core.cseip);
 	core.cseip+=4;
 	return temp;
 }
@@ -134,16 +201,25 @@ static INLINE Bit32u Fetchd() {
 #include "instructions.h"
 #include "core_normal/support.h"
 #include "core_normal/string.h"
+#if CPU_PREDECODE
+#include "core_normal/predecode.h"
+#endif
 
 
 #define EALookupTable (core.ea_table)
 
 Bits CPU_Core_Normal_Run(void) {
+#if CPU_THREADED_DISPATCH
+#include "core_normal/table_threaded.h"
+#endif
+	Bitu opcode;
+#if CPU_PREDECODE
+	// other cores may have changed page handlers
+	core.pd_lin=~(Bitu)0;
+#endif
 	while (CPU_Cycles-->0) {
 		LOADIP;
-		core.opcode_index=cpu.code.big*0x200;
-		core.prefixes=cpu.code.big;
-		core.ea_table=&EATable[cpu.code.big*256];
+		SetFetchPage();
 		BaseDS=SegBase(ds);
 		BaseSS=SegBase(ss);
 		core.base_val_ds=ds;
@@ -156,8 +232,44 @@ Bits CPU_Core_Normal_Run(void) {
 #endif
 		cycle_count++;
 #endif
+#if CPU_PREDECODE
+		SetPredecodePage();
+		core.pd_fill=nullptr;
+		if (core.pd_page) {
+			PredecodedOp * op=core.pd_page->Find(core.cseip&4095);
+			if (GCC_LIKELY(op!=nullptr)) {
+				core.op=op;
+				core.cseip+=op->skip;
+				core.prefixes=op->prefixes;
+				core.rep_zero=op->rep_zero;
+				core.ea_table=PDTable;
+				if (op->seg!=PD_NO_SEG) {
+					BaseDS=BaseSS=SegBase((SegNames)op->seg);
+					core.base_val_ds=(SegNames)op->seg;
+				}
+				opcode=op->opcode;
+				goto dispatch;
+			}
+			core.pd_fill=core.pd_page;
+			core.pd_start=core.cseip;
+			core.pd_seg=PD_NO_SEG;
+		}
+#endif
+		core.opcode_index=cpu.code.big*0x200;
+		core.prefixes=cpu.code.big;
+		core.ea_table=&EATable[cpu.code.big*256];
 restart_opcode:
-		switch (core.opcode_index+Fetchb()) {
+		opcode=core.opcode_index+Fetchb();
+#if CPU_PREDECODE
+		if (core.pd_fill && !PD_IsPrefix(opcode)) PD_Record(opcode);
+dispatch:
+#endif
+#if CPU_THREADED_DISPATCH
+		/* The switch below is only entered through these jumps, break
+		   and continue inside the handlers still work the same way */
+		goto *opcode_targets[opcode];
+#endif
+		switch (opcode) {
 		#include "core_normal/prefix_none.h"
 		#include "core_normal/prefix_0f.h"
 		#include "core_normal/prefix_66.h"
@@ -206,6 +318,14 @@ Bits CPU_Core_Normal_Trap_Run(void) {
 
 
 void CPU_Core_Normal_Init(void) {
+#if CPU_PREDECODE
+	for (Bitu i=0;i<256;i++) PDTable[i]=&EA_Predecoded;
+#endif
+}
 
+void CPU_Core_Normal_ReleasePage(MAYBE_UNUSED PageHandler * handler) {
+#if CPU_PREDECODE
+	static_cast<PredecodePageHandler *>(handler)->Release();
+#endif
 }
 
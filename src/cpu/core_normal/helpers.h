@@ -141,21 +141,29 @@
 	}																		\
 }
 
+/* With threaded dispatch every case also gets a label of its own, the
+   targets for these are listed in table_threaded.h */
+#if CPU_THREADED_DISPATCH
+#define CASE_LABEL(_NAME)	_NAME:
+#else
+#define CASE_LABEL(_NAME)
+#endif
+
 #define CASE_W(_WHICH)							\
-	case (OPCODE_NONE+_WHICH):
+	case (OPCODE_NONE+_WHICH): CASE_LABEL(op_w_ ## _WHICH)
 
 #define CASE_D(_WHICH)							\
-	case (OPCODE_SIZE+_WHICH):
+	case (OPCODE_SIZE+_WHICH): CASE_LABEL(op_d_ ## _WHICH)
 
 #define CASE_B(_WHICH)							\
 	CASE_W(_WHICH)								\
 	CASE_D(_WHICH)
 
 #define CASE_0F_W(_WHICH)						\
-	case ((OPCODE_0F|OPCODE_NONE)+_WHICH):
+	case ((OPCODE_0F|OPCODE_NONE)+_WHICH): CASE_LABEL(op_0f_w_ ## _WHICH)
 
 #define CASE_0F_D(_WHICH)						\
-	case ((OPCODE_0F|OPCODE_SIZE)+_WHICH):
+	case ((OPCODE_0F|OPCODE_SIZE)+_WHICH): CASE_LABEL(op_0f_d_ ## _WHICH)
 
 #define CASE_0F_B(_WHICH)						\
 	CASE_0F_W(_WHICH)							\
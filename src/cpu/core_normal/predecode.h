@@ -0,0 +1,321 @@
+/*
+ *  Copyright (C) 2002-2020  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Predecoded instructions of the normal core.
+
+   The first time an instruction in a RAM page is executed its prefixes,
+   the opcode index and, once the handler asks for it, its ModRM effective
+   address are decoded into a record of the page. Later executions start
+   from the record: the prefix state is set up in one go, the handler is
+   entered directly and the EA is computed from the stored registers,
+   scale and displacement without going through EATable and Sib().
+   Immediates are still fetched by the handlers, straight from the page.
+
+   A page with records gets a PredecodePageHandler, that like the
+   CodePageHandler of the dynamic cores takes the writes to the page and
+   drops the records of the instructions whose bytes were modified. */
+
+#define PD_PAGES		256		// pages that can have records at the same time
+#define PD_PAGE_OPS		1024	// records per page, the page starts over when full
+#define PD_MAX_LEN		16		// longest instruction that gets a record
+#define PD_NO_EA		0xff	// ea_len of a record without decoded EA
+#define PD_NO_SEG		0xff	// seg of a record without segment override
+
+struct PredecodedOp {
+	Bit32u * ea_base;		// base register, or SIBZero
+	Bit32u * ea_index;		// index register, or SIBZero
+	Bit32u ea_disp;
+	Bit16u opcode;			// index into the opcode switch and opcode_targets
+	Bit16u offset;			// first byte of the instruction in the page
+	Bit8u skip;				// prefix and opcode bytes
+	Bit8u len;				// bytes covered by the record, up to the end of the EA
+	Bit8u prefixes;
+	Bit8u seg;
+	Bit8u ea_len;			// SIB and displacement bytes
+	Bit8u ea_scale;
+	bool ea_ss;				// EA is relative to SS instead of DS
+	bool rep_zero;
+};
+
+class PredecodePageHandler : public PageHandler {
+public:
+	PredecodePageHandler() = default;
+
+	PredecodePageHandler(const PredecodePageHandler &) = delete; // prevent copying
+	PredecodePageHandler &operator=(const PredecodePageHandler &) = delete; // prevent assignment
+
+	void SetupAt(Bitu _phys_page,PageHandler * _old_pagehandler) {
+		phys_page=_phys_page;
+		// the old handler provides direct read access and is put back
+		// when the page gets released
+		old_pagehandler=_old_pagehandler;
+		hostmem=old_pagehandler->GetHostReadPt(phys_page);
+		// writes have to come here to keep the records up to date
+		flags=(old_pagehandler->flags|PFLAG_PREDECODED)&~PFLAG_WRITEABLE;
+		referenced=true;
+		Reset();
+	}
+
+	// drop all records, they are decoded again for the current code size
+	void Reset() {
+		memset(&slots,0,sizeof(slots));
+		memset(&write_map,0,sizeof(write_map));
+		used=0;
+		big=cpu.code.big;
+	}
+
+	PredecodedOp * Find(Bitu offset) {
+		const Bitu slot=slots[offset];
+		return slot ? &ops[slot-1] : nullptr;
+	}
+
+	// a new record for the instruction at offset, len bytes long so far
+	PredecodedOp * Add(Bitu offset,Bitu len) {
+		if (used==PD_PAGE_OPS) Reset();
+		PredecodedOp * op=&ops[used++];
+		slots[offset]=(Bit16u)used;
+		op->offset=(Bit16u)offset;
+		op->len=(Bit8u)len;
+		op->ea_len=PD_NO_EA;
+		Cover(offset,offset+len-1,1);
+		return op;
+	}
+
+	// the record got its EA decoded and covers len bytes now, the
+	// instruction has to fit into the page and the length limit
+	bool Extend(PredecodedOp * op,Bitu len) {
+		if (slots[op->offset]!=(Bit16u)(op-ops+1)) return false;
+		if (len>PD_MAX_LEN || op->offset+len>4096) {
+			Drop(op);
+			return false;
+		}
+		Cover(op->offset+op->len,op->offset+len-1,1);
+		op->len=(Bit8u)len;
+		return true;
+	}
+
+	void writeb(PhysPt addr,Bitu val) override {
+		addr&=4095;
+		if (host_readb(hostmem+addr)==(Bit8u)val) return;
+		host_writeb(hostmem+addr,val);
+		if (write_map[addr]) InvalidateRange(addr,addr);
+	}
+	void writew(PhysPt addr,Bitu val) override {
+		addr&=4095;
+		if (host_readw(hostmem+addr)==(Bit16u)val) return;
+		host_writew(hostmem+addr,val);
+		if (read_unaligned_uint16(&write_map[addr])) InvalidateRange(addr,addr+1);
+	}
+	void writed(PhysPt addr,Bitu val) override {
+		addr&=4095;
+		if (host_readd(hostmem+addr)==(Bit32u)val) return;
+		host_writed(hostmem+addr,val);
+		if (read_unaligned_uint32(&write_map[addr])) InvalidateRange(addr,addr+3);
+	}
+
+	HostPt GetHostReadPt(Bitu phys_page) override {
+		hostmem=old_pagehandler->GetHostReadPt(phys_page);
+		return hostmem;
+	}
+	HostPt GetHostWritePt(Bitu phys_page) override {
+		return GetHostReadPt(phys_page);
+	}
+
+	void Release() {
+		// somebody else may have taken over the page in the meantime
+		if (MEM_GetPageHandler(phys_page)==this) {
+			MEM_SetPageHandler(phys_page,1,old_pagehandler);
+			PAGING_ClearTLB();
+		}
+		old_pagehandler=nullptr;
+	}
+
+	bool InUse() const { return old_pagehandler!=nullptr; }
+
+	bool big = false;			// code size the records were decoded for
+	bool referenced = false;	// executed from since the last eviction scan
+
+private:
+	void Cover(Bitu start,Bitu end,int delta) {
+		for (Bitu i=start;i<=end;i++) write_map[i]+=delta;
+	}
+
+	void Drop(PredecodedOp * op) {
+		slots[op->offset]=0;
+		Cover(op->offset,op->offset+op->len-1,-1);
+	}
+
+	// drop the records of the instructions that have bytes in start..end
+	void InvalidateRange(Bitu start,Bitu end) {
+		Bitu first=start>=PD_MAX_LEN-1 ? start-(PD_MAX_LEN-1) : 0;
+		for (Bitu i=first;i<=end;i++) {
+			PredecodedOp * op=Find(i);
+			if (op && (i+op->len)>start) Drop(op);
+		}
+	}
+
+	PageHandler * old_pagehandler = nullptr;
+	HostPt hostmem = nullptr;
+	Bitu phys_page = 0;
+	Bitu used = 0;
+	// slots[i] is the number of the record for the instruction at i
+	Bit16u slots[4096] = {};
+	// write_map[i] records cover the byte at i, padded for writed
+	Bit8u write_map[4096+3] = {};
+	PredecodedOp ops[PD_PAGE_OPS] = {};
+};
+
+static PredecodePageHandler * pd_pages[PD_PAGES];
+static Bitu pd_clock=0;
+
+/* Find a page for new records, pages that haven't been executed from
+   since the last scan are released first */
+static PredecodePageHandler * PD_FreePage(void) {
+	for (;;) {
+		PredecodePageHandler * &page=pd_pages[pd_clock];
+		pd_clock=(pd_clock+1)%PD_PAGES;
+		if (!page) page=new PredecodePageHandler();
+		if (!page->InUse()) return page;
+		if (page->referenced) {
+			page->referenced=false;
+			continue;
+		}
+		page->Release();
+		return page;
+	}
+}
+
+/* Records of the page containing lin_addr, pages of plain RAM get a
+   PredecodePageHandler the first time they are executed from. Returns
+   nullptr when there are no records (yet). */
+static PredecodePageHandler * PD_GetPage(PhysPt lin_addr,PageHandler * handler) {
+	if (handler->flags & PFLAG_PREDECODED) {
+		PredecodePageHandler * page=static_cast<PredecodePageHandler *>(handler);
+		if (page->big!=cpu.code.big) page->Reset();
+		page->referenced=true;
+		return page;
+	}
+	const Bitu mask=PFLAG_READABLE|PFLAG_WRITEABLE|PFLAG_HASROM|PFLAG_HASCODE|PFLAG_NOCODE|PFLAG_INIT;
+	if ((handler->flags & mask)!=(PFLAG_READABLE|PFLAG_WRITEABLE)) return nullptr;
+	Bitu phys_page=lin_addr>>12;
+	if (!PAGING_MakePhysPage(phys_page) || phys_page>=MEM_TotalPages()) return nullptr;
+	// only pages backed by main memory, not video memory windows
+	if (MEM_GetPageHandler(phys_page)!=handler) return nullptr;
+	if (handler->GetHostReadPt(phys_page)!=MemBase+phys_page*MEM_PAGESIZE) return nullptr;
+	PredecodePageHandler * page=PD_FreePage();
+	page->SetupAt(phys_page,handler);
+	MEM_SetPageHandler(phys_page,1,page);
+	// the records are used once the page got linked again
+	PAGING_UnlinkPages(lin_addr>>12,1);
+	return nullptr;
+}
+
+/* Decode the EA of the instruction into its record, the same way as the
+   EA_16_xx_n and EA_32_xx_n functions do it. The ModRM byte was fetched
+   right before. */
+static void PD_DecodeEA(PredecodedOp * op) {
+	const PhysPt ea_start=core.cseip;
+	const Bit8u rm=LoadMb(core.cseip-1);
+	const Bitu mod=rm>>6;
+	Bit32u * base=&SIBZero;
+	Bit32u * index=&SIBZero;
+	Bit32u disp=0;
+	Bitu scale=0;
+	bool ss=false;
+	if (!(op->prefixes & PREFIX_ADDR)) {
+		switch (rm&7) {
+		case 0:base=&reg_ebx;index=&reg_esi;break;
+		case 1:base=&reg_ebx;index=&reg_edi;break;
+		case 2:base=&reg_ebp;index=&reg_esi;ss=true;break;
+		case 3:base=&reg_ebp;index=&reg_edi;ss=true;break;
+		case 4:base=&reg_esi;break;
+		case 5:base=&reg_edi;break;
+		case 6:if (mod) {base=&reg_ebp;ss=true;} break;
+		case 7:base=&reg_ebx;break;
+		}
+		if (mod==1) disp=(Bit32u)Fetchbs();
+		else if (mod==2 || (rm&7)==6) disp=Fetchw();
+	} else {
+		Bitu reg=rm&7;
+		if (reg==4) {
+			const Bit8u sib=Fetchb();
+			index=SIBIndex[(sib>>3)&7];
+			scale=sib>>6;
+			reg=sib&7;
+			if (reg==4) ss=true;
+		}
+		if (reg==5 && !mod) disp=Fetchd();
+		else {
+			base=&reg_32(reg);
+			if (reg==5) ss=true;
+		}
+		if (mod==1) disp=(Bit32u)Fetchbs();
+		else if (mod==2) disp=(Bit32u)Fetchds();
+	}
+	op->ea_base=base;
+	op->ea_index=index;
+	op->ea_disp=disp;
+	op->ea_scale=(Bit8u)scale;
+	op->ea_ss=ss;
+	op->ea_len=(Bit8u)(core.cseip-ea_start);
+}
+
+/* The EALookupTable of instructions with a record */
+static PhysPt EA_Predecoded(void) {
+	PredecodedOp * op=core.op;
+	if (GCC_UNLIKELY(op->ea_len==PD_NO_EA)) {
+		PD_DecodeEA(op);
+		// without room for it the EA is only used this time
+		core.pd_page->Extend(op,op->skip+1u+op->ea_len);
+	} else core.cseip+=op->ea_len;
+	PhysPt eaa=*op->ea_base+(*op->ea_index<<op->ea_scale)+op->ea_disp;
+	if (!(op->prefixes & PREFIX_ADDR)) eaa=(Bit16u)eaa;
+	return (op->ea_ss ? BaseSS : BaseDS)+eaa;
+}
+
+static GetEAHandler PDTable[256];
+
+static INLINE bool PD_IsPrefix(Bitu opcode) {
+	if (opcode & OPCODE_0F) return false;
+	switch (opcode & 0xff) {
+	case 0x0f:case 0x26:case 0x2e:case 0x36:case 0x3e:
+	case 0x64:case 0x65:case 0x66:case 0x67:case 0xf2:case 0xf3:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* The final opcode byte of an instruction without a record was fetched,
+   note what the prefixes did */
+static void PD_Record(Bitu opcode) {
+	PredecodePageHandler * page=core.pd_fill;
+	core.pd_fill=nullptr;
+	const Bitu skip=core.cseip-core.pd_start;
+	const Bitu offset=core.pd_start&4095;
+	// the ModRM byte that may follow belongs to the record as well
+	if (skip+1>PD_MAX_LEN || offset+skip+1>4096) return;
+	PredecodedOp * op=page->Add(offset,skip+1);
+	op->opcode=(Bit16u)opcode;
+	op->skip=(Bit8u)skip;
+	op->prefixes=(Bit8u)core.prefixes;
+	op->rep_zero=core.rep_zero;
+	op->seg=core.pd_seg;
+	core.op=op;
+	core.ea_table=PDTable;
+}
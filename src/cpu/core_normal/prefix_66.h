@@ -342,11 +342,7 @@
 			//Little hack to always use segprefixed version
 			GetRMrd;
 			BaseDS=BaseSS=0;
-			if (TEST_PREFIX_ADDR) {
-				*rmrd=(Bit32u)(*EATable[256+rm])();
-			} else {
-				*rmrd=(Bit32u)(*EATable[rm])();
-			}
+			*rmrd=(Bit32u)(*EALookupTable[rm])();
 			break;
 		}
 	CASE_D(0x8f)												/* POP Ed */
@@ -495,11 +495,7 @@
 			//Little hack to always use segprefixed version
 			BaseDS=BaseSS=0;
 			GetRMrw;
-			if (TEST_PREFIX_ADDR) {
-				*rmrw=(Bit16u)(*EATable[256+rm])();
-			} else {
-				*rmrw=(Bit16u)(*EATable[rm])();
-			}
+			*rmrw=(Bit16u)(*EALookupTable[rm])();
 			break;
 		}
 	CASE_B(0x8e)												/* MOV Sw,Ew */
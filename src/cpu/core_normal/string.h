@@ -26,6 +26,7 @@ enum STRING_OP {
 	R_CMPSB,R_CMPSW,R_CMPSD
 };
 
+
 #define LoadD(_BLAH) _BLAH
 
 static void DoString(STRING_OP type) {
@@ -101,46 +102,76 @@ static void DoString(STRING_OP type) {
 		}
 		break;
 	case R_STOSB:
-		for (;count>0;count--) {
-			SaveMb(di_base+di_index,reg_al);
-			di_index=(di_index+add_index) & add_mask;
+		while (count>0) {
+			Bitu run=StringBulkStos(di_base,di_index,add_mask,add_index,count,reg_al);
+			if (!run) {
+				SaveMb(di_base+di_index,reg_al);
+				run=1;
+			}
+			di_index=(di_index+add_index*run) & add_mask;
+			count-=run;
 		}
 		break;
 	case R_STOSW:
 		add_index<<=1;
-		for (;count>0;count--) {
-			SaveMw(di_base+di_index,reg_ax);
-			di_index=(di_index+add_index) & add_mask;
+		while (count>0) {
+			Bitu run=StringBulkStos(di_base,di_index,add_mask,add_index,count,reg_ax);
+			if (!run) {
+				SaveMw(di_base+di_index,reg_ax);
+				run=1;
+			}
+			di_index=(di_index+add_index*run) & add_mask;
+			count-=run;
 		}
 		break;
 	case R_STOSD:
 		add_index<<=2;
-		for (;count>0;count--) {
-			SaveMd(di_base+di_index,reg_eax);
-			di_index=(di_index+add_index) & add_mask;
+		while (count>0) {
+			Bitu run=StringBulkStos(di_base,di_index,add_mask,add_index,count,reg_eax);
+			if (!run) {
+				SaveMd(di_base+di_index,reg_eax);
+				run=1;
+			}
+			di_index=(di_index+add_index*run) & add_mask;
+			count-=run;
 		}
 		break;
 	case R_MOVSB:
-		for (;count>0;count--) {
-			SaveMb(di_base+di_index,LoadMb(si_base+si_index));
-			di_index=(di_index+add_index) & add_mask;
-			si_index=(si_index+add_index) & add_mask;
+		while (count>0) {
+			Bitu run=StringBulkMovs(si_base,si_index,di_base,di_index,add_mask,add_index,count);
+			if (!run) {
+				SaveMb(di_base+di_index,LoadMb(si_base+si_index));
+				run=1;
+			}
+			di_index=(di_index+add_index*run) & add_mask;
+			si_index=(si_index+add_index*run) & add_mask;
+			count-=run;
 		}
 		break;
 	case R_MOVSW:
 		add_index<<=1;
-		for (;count>0;count--) {
-			SaveMw(di_base+di_index,LoadMw(si_base+si_index));
-			di_index=(di_index+add_index) & add_mask;
-			si_index=(si_index+add_index) & add_mask;
+		while (count>0) {
+			Bitu run=StringBulkMovs(si_base,si_index,di_base,di_index,add_mask,add_index,count);
+			if (!run) {
+				SaveMw(di_base+di_index,LoadMw(si_base+si_index));
+				run=1;
+			}
+			di_index=(di_index+add_index*run) & add_mask;
+			si_index=(si_index+add_index*run) & add_mask;
+			count-=run;
 		}
 		break;
 	case R_MOVSD:
 		add_index<<=2;
-		for (;count>0;count--) {
-			SaveMd(di_base+di_index,LoadMd(si_base+si_index));
-			di_index=(di_index+add_index) & add_mask;
-			si_index=(si_index+add_index) & add_mask;
+		while (count>0) {
+			Bitu run=StringBulkMovs(si_base,si_index,di_base,di_index,add_mask,add_index,count);
+			if (!run) {
+				SaveMd(di_base+di_index,LoadMd(si_base+si_index));
+				run=1;
+			}
+			di_index=(di_index+add_index*run) & add_mask;
+			si_index=(si_index+add_index*run) & add_mask;
+			count-=run;
 		}
 		break;
 	case R_LODSB:
@@ -167,9 +198,16 @@ static void DoString(STRING_OP type) {
 		{
 			Bit8u val2;
 			for (;count>0;) {
-				count--;CPU_Cycles--;
-				val2=LoadMb(di_base+di_index);
-				di_index=(di_index+add_index) & add_mask;
+				Bit32u last;
+				Bitu run=StringBulkScas(di_base,di_index,add_mask,add_index,count,reg_al,core.rep_zero,last);
+				if (run) {
+					val2=(Bit8u)last;
+				} else {
+					val2=LoadMb(di_base+di_index);
+					run=1;
+				}
+				count-=run;CPU_Cycles-=run;
+				di_index=(di_index+add_index*run) & add_mask;
 				if ((reg_al==val2)!=core.rep_zero) break;
 			}
 			CMPB(reg_al,val2,LoadD,0);
@@ -179,9 +217,16 @@ static void DoString(STRING_OP type) {
 		{
 			add_index<<=1;Bit16u val2;
 			for (;count>0;) {
-				count--;CPU_Cycles--;
-				val2=LoadMw(di_base+di_index);
-				di_index=(di_index+add_index) & add_mask;
+				Bit32u last;
+				Bitu run=StringBulkScas(di_base,di_index,add_mask,add_index,count,reg_ax,core.rep_zero,last);
+				if (run) {
+					val2=(Bit16u)last;
+				} else {
+					val2=LoadMw(di_base+di_index);
+					run=1;
+				}
+				count-=run;CPU_Cycles-=run;
+				di_index=(di_index+add_index*run) & add_mask;
 				if ((reg_ax==val2)!=core.rep_zero) break;
 			}
 			CMPW(reg_ax,val2,LoadD,0);
@@ -191,9 +236,16 @@ static void DoString(STRING_OP type) {
 		{
 			add_index<<=2;Bit32u val2;
 			for (;count>0;) {
-				count--;CPU_Cycles--;
-				val2=LoadMd(di_base+di_index);
-				di_index=(di_index+add_index) & add_mask;
+				Bit32u last;
+				Bitu run=StringBulkScas(di_base,di_index,add_mask,add_index,count,reg_eax,core.rep_zero,last);
+				if (run) {
+					val2=(Bit32u)last;
+				} else {
+					val2=LoadMd(di_base+di_index);
+					run=1;
+				}
+				count-=run;CPU_Cycles-=run;
+				di_index=(di_index+add_index*run) & add_mask;
 				if ((reg_eax==val2)!=core.rep_zero) break;
 			}
 			CMPD(reg_eax,val2,LoadD,0);
@@ -203,11 +255,19 @@ static void DoString(STRING_OP type) {
 		{
 			Bit8u val1,val2;
 			for (;count>0;) {
-				count--;CPU_Cycles--;
-				val1=LoadMb(si_base+si_index);
-				val2=LoadMb(di_base+di_index);
-				si_index=(si_index+add_index) & add_mask;
-				di_index=(di_index+add_index) & add_mask;
+				Bit32u last1,last2;
+				Bitu run=StringBulkCmps(si_base,si_index,di_base,di_index,add_mask,add_index,count,core.rep_zero,last1,last2);
+				if (run) {
+					val1=(Bit8u)last1;
+					val2=(Bit8u)last2;
+				} else {
+					val1=LoadMb(si_base+si_index);
+					val2=LoadMb(di_base+di_index);
+					run=1;
+				}
+				count-=run;CPU_Cycles-=run;
+				si_index=(si_index+add_index*run) & add_mask;
+				di_index=(di_index+add_index*run) & add_mask;
 				if ((val1==val2)!=core.rep_zero) break;
 			}
 			CMPB(val1,val2,LoadD,0);
@@ -217,11 +277,19 @@ static void DoString(STRING_OP type) {
 		{
 			add_index<<=1;Bit16u val1,val2;
 			for (;count>0;) {
-				count--;CPU_Cycles--;
-				val1=LoadMw(si_base+si_index);
-				val2=LoadMw(di_base+di_index);
-				si_index=(si_index+add_index) & add_mask;
-				di_index=(di_index+add_index) & add_mask;
+				Bit32u last1,last2;
+				Bitu run=StringBulkCmps(si_base,si_index,di_base,di_index,add_mask,add_index,count,core.rep_zero,last1,last2);
+				if (run) {
+					val1=(Bit16u)last1;
+					val2=(Bit16u)last2;
+				} else {
+					val1=LoadMw(si_base+si_index);
+					val2=LoadMw(di_base+di_index);
+					run=1;
+				}
+				count-=run;CPU_Cycles-=run;
+				si_index=(si_index+add_index*run) & add_mask;
+				di_index=(di_index+add_index*run) & add_mask;
 				if ((val1==val2)!=core.rep_zero) break;
 			}
 			CMPW(val1,val2,LoadD,0);
@@ -231,11 +299,19 @@ static void DoString(STRING_OP type) {
 		{
 			add_index<<=2;Bit32u val1,val2;
 			for (;count>0;) {
-				count--;CPU_Cycles--;
-				val1=LoadMd(si_base+si_index);
-				val2=LoadMd(di_base+di_index);
-				si_index=(si_index+add_index) & add_mask;
-				di_index=(di_index+add_index) & add_mask;
+				Bit32u last1,last2;
+				Bitu run=StringBulkCmps(si_base,si_index,di_base,di_index,add_mask,add_index,count,core.rep_zero,last1,last2);
+				if (run) {
+					val1=(Bit32u)last1;
+					val2=(Bit32u)last2;
+				} else {
+					val1=LoadMd(si_base+si_index);
+					val2=LoadMd(di_base+di_index);
+					run=1;
+				}
+				count-=run;CPU_Cycles-=run;
+				si_index=(si_index+add_index*run) & add_mask;
+				di_index=(di_index+add_index*run) & add_mask;
 				if ((val1==val2)!=core.rep_zero) break;
 			}
 			CMPD(val1,val2,LoadD,0);
@@ -28,6 +28,7 @@
 #include "pic.h"
 #include "fpu.h"
 #include "paging.h"
+#include "string_bulk.h"
 
 #if C_DEBUG
 #include "debug.h"
@@ -32,6 +32,7 @@
 #endif
 
 #include "paging.h"
+#include "string_bulk.h"
 #define SegBase(c)	SegPhys(c)
 #define LoadMb(off) mem_readb(off)
 #define LoadMw(off) mem_readw(off)
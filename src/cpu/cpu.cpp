@@ -30,6 +30,8 @@
 #include "paging.h"
 #include "lazyflags.h"
 #include "support.h"
+#include "snapshot.h"
+#include "auto_cycles.h"
 
 Bitu DEBUG_EnableDebugger(void);
 extern void GFX_SetTitle(Bit32s cycles ,int frameskip,bool paused);
@@ -75,11 +77,15 @@ void CPU_Core_Simple_Init(void);
 void CPU_Core_Dyn_X86_Init(void);
 void CPU_Core_Dyn_X86_Cache_Init(bool enable_cache);
 void CPU_Core_Dyn_X86_Cache_Close(void);
+void CPU_Core_Dyn_X86_SetCacheSize(Bitu size_mb, bool growable);
 void CPU_Core_Dyn_X86_SetFPUMode(bool dh_fpu);
 #elif (C_DYNREC)
 void CPU_Core_Dynrec_Init(void);
 void CPU_Core_Dynrec_Cache_Init(bool enable_cache);
 void CPU_Core_Dynrec_Cache_Close(void);
+void CPU_Core_Dynrec_SetCacheSize(Bitu size_mb, bool growable);
+void CPU_Core_Dynrec_SetLazyTranslation(bool enabled);
+void CPU_Core_Dynrec_SetHotPagesFile(const std::string &file);
 #endif
 
 /* In debug mode exceptions are tested and dosbox exits when 
@@ -2048,6 +2054,10 @@ void CPU_HLT(Bitu oldeip) {
 	cpudecoder=&HLT_Decode;
 }
 
+bool CPU_IsHalted(void) {
+	return cpudecoder==&HLT_Decode;
+}
+
 void CPU_ENTER(bool use32,Bitu bytes,Bitu level) {
 	level&=0x1f;
 	Bitu sp_index=reg_esp&cpu.stack.mask;
@@ -2150,6 +2160,33 @@ void CPU_Reset_AutoAdjust(void) {
 	CPU_IODelayRemoved = 0;
 	ticksDone = 0;
 	ticksScheduled = 0;
+	AUTOCYCLES_Reset();
+}
+
+/* The blocks are stored as they are in memory, their sizes guard against
+ * loading a snapshot of a build with a different Bitu */
+static void CPU_SaveState(SnapshotWriter &out) {
+	FillFlags();
+	out.Write(static_cast<Bit32u>(sizeof(cpu_regs)+sizeof(Segs)+sizeof(cpu)+sizeof(cpu_tss)));
+	out.Write(cpu_regs);
+	out.Write(Segs);
+	out.Write(&cpu,sizeof(cpu));
+	out.Write(&cpu_tss,sizeof(cpu_tss));
+}
+
+static bool CPU_LoadState(SnapshotReader &in,bool apply) {
+	Bit32u size;
+	if (!in.Read(size) || size!=sizeof(cpu_regs)+sizeof(Segs)+sizeof(cpu)+sizeof(cpu_tss)) return false;
+	if (!apply) return in.Skip(size);
+	/* The halt state refers to the running decoder, that one is kept */
+	const auto hlt=cpu.hlt;
+	in.Read(cpu_regs);
+	in.Read(Segs);
+	in.Read(&cpu,sizeof(cpu));
+	in.Read(&cpu_tss,sizeof(cpu_tss));
+	cpu.hlt=hlt;
+	lflags.type=t_UNKNOWN;
+	return true;
 }
 
 class CPU: public Module_base {
@@ -2200,6 +2237,7 @@ public:
 			cpu.drx[6]=0xffff1ff0;
 		}
 		cpu.drx[7]=0x00000400;
+		SNAPSHOT_Register("cpu",1,CPU_SaveState,CPU_LoadState);
 
 		/* Init the cpu cores */
 		CPU_Core_Normal_Init();
@@ -2334,8 +2372,14 @@ public:
 		}
 
 #if (C_DYNAMIC_X86)
+		CPU_Core_Dyn_X86_SetCacheSize(section->Get_int("dynamic_cache_size"),
+		                              section->Get_bool("dynamic_cache_grow"));
 		CPU_Core_Dyn_X86_Cache_Init((core == "dynamic") || (core == "dynamic_nodhfpu"));
 #elif (C_DYNREC)
+		CPU_Core_Dynrec_SetCacheSize(section->Get_int("dynamic_cache_size"),
+		                             section->Get_bool("dynamic_cache_grow"));
+		CPU_Core_Dynrec_SetLazyTranslation(section->Get_bool("dynamic_lazy_translation"));
+		CPU_Core_Dynrec_SetHotPagesFile(section->Get_path("dynamic_hot_pages")->realpath);
 		CPU_Core_Dynrec_Cache_Init( core == "dynamic" );
 #endif
 
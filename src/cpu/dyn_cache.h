@@ -72,6 +72,10 @@ public:
 	} link[2];                // maximum two links (conditional jumps)
 
 	CacheBlock *crossblock;
+
+	// executions left until the block is retranslated as a trace,
+	// decremented by the block itself (dynrec core only)
+	uint32_t hot_count;
 };
 
 static struct {
@@ -89,6 +93,11 @@ static struct {
 } cache;
 
 // cache memory pointers, to be malloc'd later
+// note: the generated code is not position independent, it embeds absolute
+// host addresses (cpu_regs, helper functions, CacheBlock and page handler
+// pointers, link_blocks) that differ between runs, so translated blocks can
+// not be stored on disk and reloaded; the cache always starts out empty, only
+// the guest side (see core_dynrec/hot_pages.h) can be kept between runs
 static uint8_t *cache_code_start_ptr = nullptr;
 static uint8_t *cache_code = nullptr;
 static uint8_t *cache_code_link_blocks = nullptr;
@@ -96,6 +105,38 @@ static uint8_t *cache_code_link_blocks = nullptr;
 static CacheBlock *cache_blocks = nullptr;
 static CacheBlock link_blocks[2]; // default linking (specially marked)
 
+// dimensions of the cache, CACHE_TOTAL/CACHE_BLOCKS/CACHE_PAGES are the
+// defaults that can be changed through cache_set_size() before first use
+static Bitu cache_total_size = CACHE_TOTAL;
+static Bitu cache_block_count = CACHE_BLOCKS;
+static Bitu cache_page_count = CACHE_PAGES;
+
+// the cache can be rebuilt with twice its size when too much translated
+// code has to be evicted within a window of translated blocks
+#define CACHE_GROW_WINDOW (16 * 1024)
+#define CACHE_TOTAL_MAX   (1024 * 1024 * 512)
+
+static struct {
+	bool enabled;
+	bool pending;     // grow at the next safe point (outside of any block)
+	Bitu translated;  // blocks translated in the current window
+	Bitu wraps;       // restarts of the code memory in the current window
+	Bitu evictions;   // code pages dropped in the current window
+} cache_growth = {false, false, 0, 0, 0};
+
+// self-modifying code statistics, show how often translated code has
+// to be thrown away because the guest wrote to it
+static struct {
+	Bitu data_writes;   // writes to code pages that hit no translated code
+	Bitu code_writes;   // writes that hit bytes covered by translated code
+	Bitu invalidations; // blocks cleared because their code was modified
+	Bitu blocks_kept;   // blocks spared because only masked bytes changed
+} cache_smc = {0, 0, 0, 0};
+
+// translation misses on a fresh code page that are left to the normal
+// core before the page gets translated (0 translates right away)
+static Bitu cache_cold_runs = 0;
+
 // the CodePageHandler class provides access to the contained
 // cache blocks and intercepts writes to the code for special treatment
 class CodePageHandler : public PageHandler {
@@ -118,6 +159,8 @@ public:
 
 		active_blocks=0;
 		active_count=16;
+		cold_runs=cache_cold_runs;
+		hot_checked=false;
 
 		// initialize the maps with zero (no cache blocks as well as
 		// code present)
@@ -129,9 +172,26 @@ public:
 		}
 	}
 
+	// test if the block was translated from any byte in start..end,
+	// bytes in the wmapmask (immediates that the translated code reads
+	// from memory, code skipped by a trace) can be modified freely
+	static bool BlockHasCodeIn(const CacheBlock *block, Bitu start, Bitu end)
+	{
+		if (start<block->page.start) start=block->page.start;
+		if (end>block->page.end) end=block->page.end;
+		if (!block->cache.wmapmask) return start<=end;
+		for (Bitu i=start;i<=end;i++) {
+			if (i<block->cache.maskstart) return true;
+			Bitu maskct=i-block->cache.maskstart;
+			if ((maskct>=block->cache.masklen) || (!block->cache.wmapmask[maskct])) return true;
+		}
+		return false;
+	}
+
 	// clear out blocks that contain code which has been modified
 	bool InvalidateRange(Bitu start, Bitu end)
 	{
+		cache_smc.code_writes++;
 		Bits index=1+(end>>DYN_HASH_SHIFT);
 		bool is_current_block = false; // if the current block is
 		                               // modified, it has to be exited
@@ -151,10 +211,16 @@ public:
 				CacheBlock *nextblock = block->hash.next;
 				// test if this block is in the range
 				if (start<=block->page.end && end>=block->page.start) {
-					if (ip_point<=block->page.end && ip_point>=block->page.start) is_current_block=true;
-					block->Clear(); // clear the block,
-					                // decrements the
-					                // write_map accordingly
+					if (!BlockHasCodeIn(block,start,end)) {
+						// only data inside the block's range was written
+						cache_smc.blocks_kept++;
+					} else {
+						if (ip_point<=block->page.end && ip_point>=block->page.start) is_current_block=true;
+						cache_smc.invalidations++;
+						block->Clear(); // clear the block,
+						                // decrements the
+						                // write_map accordingly
+					}
 				}
 				block=nextblock;
 			}
@@ -186,6 +252,7 @@ public:
 		host_writeb(hostmem+addr,val);
 		// see if there's code where we are writing to
 		if (!write_map[addr]) {
+			cache_smc.data_writes++;
 			if (active_blocks)
 				return; // still some blocks in this page
 			active_count--;
@@ -210,6 +277,7 @@ public:
 		host_writew(hostmem+addr,val);
 		// see if there's code where we are writing to
 		if (!read_unaligned_uint16(&write_map[addr])) {
+			cache_smc.data_writes++;
 			if (active_blocks)
 				return; // still some blocks in this page
 			active_count--;
@@ -234,6 +302,7 @@ public:
 		host_writed(hostmem+addr,val);
 		// see if there's code where we are writing to
 		if (!read_unaligned_uint32(&write_map[addr])) {
+			cache_smc.data_writes++;
 			if (active_blocks)
 				return; // still some blocks in this page
 			active_count--;
@@ -257,6 +326,7 @@ public:
 		if (host_readb(hostmem+addr)==(Bit8u)val) return false;
 		// see if there's code where we are writing to
 		if (!write_map[addr]) {
+			cache_smc.data_writes++;
 			if (!active_blocks) {
 				// no blocks left in this page, still delay
 				// the page releasing a bit
@@ -286,6 +356,7 @@ public:
 		if (host_readw(hostmem+addr)==(Bit16u)val) return false;
 		// see if there's code where we are writing to
 		if (!read_unaligned_uint16(&write_map[addr])) {
+			cache_smc.data_writes++;
 			if (!active_blocks) {
 				// no blocks left in this page, still delay
 				// the page releasing a bit
@@ -315,6 +386,7 @@ public:
 		if (host_readd(hostmem+addr)==(Bit32u)val) return false;
 		// see if there's code where we are writing to
 		if (!read_unaligned_uint32(&write_map[addr])) {
+			cache_smc.data_writes++;
 			if (!active_blocks) {
 				// no blocks left in this page, still delay
 				// the page releasing a bit
@@ -447,11 +519,15 @@ public:
 		return GetHostReadPt(phys_page);
 	}
 
+	Bitu GetPhysPage() const { return phys_page; }
+
 public:
 	// the write map, there are write_map[i] cache blocks that cover
 	// the byte at address i
 	uint8_t write_map[4096] = {};
 	uint8_t *invalidation_map = nullptr;
+	Bitu cold_runs = 0; // misses still run by the normal core
+	bool hot_checked = false; // looked up in the hot page list (dynrec only)
 
 	CodePageHandler *prev = nullptr;
 	CodePageHandler *next = nullptr;
@@ -476,6 +552,28 @@ static inline void cache_add_unused_block(CacheBlock *block)
 	cache.block.free = block;
 }
 
+// a code page had to be dropped to make room for a new one
+static inline void cache_note_eviction()
+{
+	cache_growth.evictions++;
+}
+
+static void cache_track_usage(bool wrapped)
+{
+	if (wrapped)
+		cache_growth.wraps++;
+	if (++cache_growth.translated < CACHE_GROW_WINDOW)
+		return;
+	if (cache_growth.wraps >= 2 ||
+	    cache_growth.evictions >= cache_page_count / 2) {
+		if (cache_total_size * 2 <= CACHE_TOTAL_MAX)
+			cache_growth.pending = true;
+	}
+	cache_growth.translated = 0;
+	cache_growth.wraps = 0;
+	cache_growth.evictions = 0;
+}
+
 static CacheBlock *cache_getblock()
 {
 	// get a free cache block and advance the free pointer
@@ -605,10 +703,12 @@ static void cache_closeblock()
 #if (C_DYNAMIC_X86)
 	const bool cache_is_full = !block->cache.next;
 #elif (C_DYNREC)
-	const uint8_t *limit = (cache_code_start_ptr + CACHE_TOTAL - CACHE_MAXSIZE);
+	const uint8_t *limit = (cache_code_start_ptr + cache_total_size - CACHE_MAXSIZE);
 	const bool cache_is_full = (!block->cache.next ||
 	                            (block->cache.next->cache.start > limit));
 #endif
+	if (cache_growth.enabled)
+		cache_track_usage(cache_is_full);
 	if (cache_is_full) {
 		// DEBUG_LOG_MSG("Cache full; restarting");
 		cache.block.active=cache.block.first;
@@ -662,111 +762,206 @@ static void cache_block_closing(uint8_t *block_start, Bitu block_size);
 #endif
 
 static bool cache_initialized = false;
+// whether cache_code_start_ptr came from VirtualAlloc
+static bool cache_code_virtualalloc = false;
 
-static void cache_init(bool enable) {
-	Bits i;
-	if (enable) {
-		// see if cache is already initialized
-		if (cache_initialized) return;
-		cache_initialized = true;
-		if (cache_blocks == NULL) {
-			// allocate the cache blocks memory
-			cache_blocks = (CacheBlock *)malloc(CACHE_BLOCKS *
-			                                    sizeof(CacheBlock));
-			if (!cache_blocks)
-				E_Exit("Allocating cache_blocks has failed");
-			memset(cache_blocks, 0, sizeof(CacheBlock) * CACHE_BLOCKS);
-			cache.block.free=&cache_blocks[0];
-			// initialize the cache blocks
-			for (i=0;i<CACHE_BLOCKS-1;i++) {
-				cache_blocks[i].link[0].to = (CacheBlock *)1;
-				cache_blocks[i].link[1].to = (CacheBlock *)1;
-				cache_blocks[i].cache.next = &cache_blocks[i + 1];
-			}
-		}
-		if (cache_code_start_ptr==NULL) {
-			// allocate the code cache memory
+// allocate the code cache memory, including space for the link blocks
+// page, block overruns and the alignment at a page boundary; virtualalloc
+// tells how this buffer has to be freed
+static uint8_t *cache_alloc_code_memory(Bitu total, bool &virtualalloc)
+{
+	const Bitu size = total + CACHE_MAXSIZE + PAGESIZE_TEMP - 1 + PAGESIZE_TEMP;
+	virtualalloc = false;
 #if defined (WIN32)
-			cache_code_start_ptr=(Bit8u*)VirtualAlloc(0,CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP,
-				MEM_COMMIT,PAGE_EXECUTE_READWRITE);
-			if (!cache_code_start_ptr)
-				cache_code_start_ptr=(Bit8u*)malloc(CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
-#else
-			cache_code_start_ptr=(Bit8u*)malloc(CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
+	uint8_t *ptr = (Bit8u *)VirtualAlloc(0, size, MEM_COMMIT,
+	                                     PAGE_EXECUTE_READWRITE);
+	virtualalloc = (ptr != NULL);
+	if (ptr)
+		return ptr;
 #endif
-			if (!cache_code_start_ptr)
-				E_Exit("Allocating dynamic core cache memory failed");
+	return (Bit8u *)malloc(size);
+}
+
+static void cache_free_code_memory(uint8_t *ptr, MAYBE_UNUSED bool virtualalloc)
+{
+#if defined (WIN32)
+	if (virtualalloc) {
+		VirtualFree(ptr, 0, MEM_RELEASE);
+		return;
+	}
+#endif
+	free(ptr);
+}
 
-			// align the cache at a page boundary
-			cache_code = (Bit8u *)(((Bitu)cache_code_start_ptr +
-			                        PAGESIZE_TEMP - 1) &
-			                       ~(PAGESIZE_TEMP - 1)); // Bitu is
-			                                              // same size
-			                                              // as a
-			                                              // pointer.
+static void cache_setup_blocks()
+{
+	// allocate the cache blocks memory
+	cache_blocks = (CacheBlock *)malloc(cache_block_count * sizeof(CacheBlock));
+	if (!cache_blocks)
+		E_Exit("Allocating cache_blocks has failed");
+	memset(cache_blocks, 0, sizeof(CacheBlock) * cache_block_count);
+	cache.block.free=&cache_blocks[0];
+	// initialize the cache blocks
+	for (Bitu i = 0; i < cache_block_count - 1; i++) {
+		cache_blocks[i].link[0].to = (CacheBlock *)1;
+		cache_blocks[i].link[1].to = (CacheBlock *)1;
+		cache_blocks[i].cache.next = &cache_blocks[i + 1];
+	}
+}
+
+static void cache_setup_code()
+{
+	// align the cache at a page boundary
+	cache_code = (Bit8u *)(((Bitu)cache_code_start_ptr + PAGESIZE_TEMP - 1) &
+	                       ~(PAGESIZE_TEMP - 1)); // Bitu is same size as a
+	                                              // pointer.
 
-			cache_code_link_blocks=cache_code;
-			cache_code += PAGESIZE_TEMP;
+	cache_code_link_blocks=cache_code;
+	cache_code += PAGESIZE_TEMP;
 
 #if (C_HAVE_MPROTECT)
-			if(mprotect(cache_code_link_blocks,CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP,PROT_WRITE|PROT_READ|PROT_EXEC))
-				LOG_MSG("Setting execute permission on the code cache has failed");
+	if(mprotect(cache_code_link_blocks,cache_total_size+CACHE_MAXSIZE+PAGESIZE_TEMP,PROT_WRITE|PROT_READ|PROT_EXEC))
+		LOG_MSG("Setting execute permission on the code cache has failed");
 #endif
-			CacheBlock *block = cache_getblock();
-			cache.block.first=block;
-			cache.block.active=block;
-			block->cache.start=&cache_code[0];
-			block->cache.size=CACHE_TOTAL;
-			block->cache.next = 0; // last block in the list
-		}
-		// setup the default blocks for block linkage returns
-		cache.pos=&cache_code_link_blocks[0];
+	CacheBlock *block = cache_getblock();
+	cache.block.first=block;
+	cache.block.active=block;
+	block->cache.start=&cache_code[0];
+	block->cache.size=cache_total_size;
+	block->cache.next = 0; // last block in the list
+}
+
+static void cache_setup_link_code()
+{
+	// setup the default blocks for block linkage returns
+	cache.pos=&cache_code_link_blocks[0];
 #if (C_DYNAMIC_X86)
-		link_blocks[0].cache.start=cache.pos;
-		gen_return(BR_Link1);
-		cache.pos=&cache_code_link_blocks[32];
-		link_blocks[1].cache.start=cache.pos;
-		gen_return(BR_Link2);
+	link_blocks[0].cache.start=cache.pos;
+	gen_return(BR_Link1);
+	cache.pos=&cache_code_link_blocks[32];
+	link_blocks[1].cache.start=cache.pos;
+	gen_return(BR_Link2);
 #elif (C_DYNREC)
-		core_dynrec.runcode = (BlockReturn(*)(uint8_t *))cache.pos;
-		// can use op to PAGESIZE_TEMP-64 bytes
-		dyn_run_code();
-		cache_block_before_close();
-		cache_block_closing(cache_code_link_blocks,
-		                    cache.pos - cache_code_link_blocks);
-
-		cache.pos = &cache_code_link_blocks[PAGESIZE_TEMP - 64];
-		link_blocks[0].cache.start = cache.pos;
-		// link code that returns with a special return code
-		// must be less than 32 bytes
-		dyn_return(BR_Link1, false);
-		cache_block_before_close();
-		cache_block_closing(link_blocks[0].cache.start,
-		                    cache.pos - link_blocks[0].cache.start);
-
-		cache.pos = &cache_code_link_blocks[PAGESIZE_TEMP - 32];
-		link_blocks[1].cache.start = cache.pos;
-		// link code that returns with a special return code
-		// must be less than 32 bytes
-		dyn_return(BR_Link2, false);
-		cache_block_before_close();
-		cache_block_closing(link_blocks[1].cache.start,
-		                    cache.pos - link_blocks[1].cache.start);
+	core_dynrec.runcode = (BlockReturn(*)(uint8_t *))cache.pos;
+	// can use op to PAGESIZE_TEMP-64 bytes
+	dyn_run_code();
+	cache_block_before_close();
+	cache_block_closing(cache_code_link_blocks,
+	                    cache.pos - cache_code_link_blocks);
+
+	cache.pos = &cache_code_link_blocks[PAGESIZE_TEMP - 64];
+	link_blocks[0].cache.start = cache.pos;
+	// link code that returns with a special return code
+	// must be less than 32 bytes
+	dyn_return(BR_Link1, false);
+	cache_block_before_close();
+	cache_block_closing(link_blocks[0].cache.start,
+	                    cache.pos - link_blocks[0].cache.start);
+
+	cache.pos = &cache_code_link_blocks[PAGESIZE_TEMP - 32];
+	link_blocks[1].cache.start = cache.pos;
+	// link code that returns with a special return code
+	// must be less than 32 bytes
+	dyn_return(BR_Link2, false);
+	cache_block_before_close();
+	cache_block_closing(link_blocks[1].cache.start,
+	                    cache.pos - link_blocks[1].cache.start);
 #endif
+}
+
+static void cache_add_pages(Bitu count)
+{
+	// setup the code pages
+	for (Bitu i = 0; i < count; i++) {
+		CodePageHandler *newpage = new CodePageHandler();
+		newpage->next=cache.free_pages;
+		cache.free_pages=newpage;
+	}
+}
+
+// set the size of the code cache in MB, the number of cache blocks and
+// code pages scale along with it; has no effect once the cache is in use
+static void cache_set_size(Bitu size_mb, bool growable)
+{
+	if (cache_initialized)
+		return;
+	cache_total_size = size_mb * 1024 * 1024;
+	cache_block_count = (Bitu)((uint64_t)CACHE_BLOCKS * cache_total_size / CACHE_TOTAL);
+	cache_page_count = (Bitu)((uint64_t)CACHE_PAGES * cache_total_size / CACHE_TOTAL);
+	cache_growth.enabled = growable;
+}
+
+static void cache_init(bool enable) {
+	if (enable) {
+		// see if cache is already initialized
+		if (cache_initialized) return;
+		cache_initialized = true;
+		if (cache_blocks == NULL)
+			cache_setup_blocks();
+		if (cache_code_start_ptr==NULL) {
+			cache_code_start_ptr = cache_alloc_code_memory(cache_total_size,
+			                                               cache_code_virtualalloc);
+			if (!cache_code_start_ptr)
+				E_Exit("Allocating dynamic core cache memory failed");
+			cache_setup_code();
+		}
+		cache_setup_link_code();
 
 		cache.free_pages=0;
 		cache.last_page=0;
 		cache.used_pages=0;
-		// setup the code pages
-		for (i=0;i<CACHE_PAGES;i++) {
-			CodePageHandler *newpage = new CodePageHandler();
-			newpage->next=cache.free_pages;
-			cache.free_pages=newpage;
-		}
+		cache_add_pages(cache_page_count);
+	}
+}
+
+// rebuild the cache with twice its size, all translated code is dropped;
+// must only be called when no generated code is being executed
+static bool cache_grow()
+{
+	cache_growth.pending = false;
+	if (!cache_initialized)
+		return false;
+
+	const Bitu new_size = cache_total_size * 2;
+	bool new_code_virtualalloc;
+	uint8_t *new_code = cache_alloc_code_memory(new_size, new_code_virtualalloc);
+	if (!new_code) {
+		LOG_MSG("DYNCACHE: Can't grow the code cache beyond %" PRIuPTR " MB",
+		        cache_total_size / (1024 * 1024));
+		cache_growth.enabled = false;
+		return false;
 	}
+
+	// release all code pages, this restores the original page handlers
+	while (cache.used_pages)
+		cache.used_pages->ClearRelease();
+	cache.block.running = nullptr;
+
+	free(cache_blocks);
+	cache_free_code_memory(cache_code_start_ptr, cache_code_virtualalloc);
+
+	cache_total_size = new_size;
+	cache_block_count *= 2;
+	cache_add_pages(cache_page_count);
+	cache_page_count *= 2;
+
+	cache_setup_blocks();
+	cache_code_start_ptr = new_code;
+	cache_code_virtualalloc = new_code_virtualalloc;
+	cache_setup_code();
+	cache_setup_link_code();
+
+	LOG_MSG("DYNCACHE: Code cache grown to %" PRIuPTR " MB",
+	        cache_total_size / (1024 * 1024));
+	return true;
 }
 
 static void cache_close(void) {
+	LOG(LOG_CPU, LOG_NORMAL)("DYNCACHE: %" PRIuPTR " data and %" PRIuPTR
+	                         " code writes to code pages, %" PRIuPTR
+	                         " blocks invalidated, %" PRIuPTR " kept",
+	                         cache_smc.data_writes, cache_smc.code_writes,
+	                         cache_smc.invalidations, cache_smc.blocks_kept);
 /*	for (;;) {
 		if (cache.used_pages) {
 			CodePageHandler * cpage=cache.used_pages;
@@ -781,9 +976,8 @@ static void cache_close(void) {
 		cache_blocks = NULL;
 	}
 	if (cache_code_start_ptr != NULL) {
-		### care: under windows VirtualFree() has to be used if
-		###       VirtualAlloc was used for memory allocation
-		free(cache_code_start_ptr);
+		cache_free_code_memory(cache_code_start_ptr,
+		                       cache_code_virtualalloc);
 		cache_code_start_ptr = NULL;
 	}
 	cache_code = NULL;
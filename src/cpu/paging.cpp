@@ -28,6 +28,7 @@
 #include "cpu.h"
 #include "debug.h"
 #include "setup.h"
+#include "snapshot.h"
 
 #define LINK_TOTAL		(64*1024)
 
@@ -95,6 +96,9 @@ bool PageHandler::writew_checked(PhysPt addr,Bitu val) {
 bool PageHandler::writed_checked(PhysPt addr,Bitu val) {
 	writed(addr,val);	return false;
 }
+bool PageHandler::writeblock(PhysPt /*addr*/,const Bit8u * /*data*/,Bitu /*count*/) {
+	return false;
+}
 
 
 
@@ -470,6 +474,11 @@ public:
 	}
 };
 
+/* Writes through the read pointer of a read only linked page */
+static INLINE void UserROMarkDirty(PhysPt addr) {
+	if (GCC_UNLIKELY(MemDirtyTracking)) MEM_MarkPageDirty(PAGING_GetPhysicalPage(addr)>>12);
+}
+
 class InitPageUserROHandler : public PageHandler {
 public:
 	InitPageUserROHandler() {
@@ -477,23 +486,29 @@ public:
 	}
 	void writeb(PhysPt addr,Bitu val) {
 		InitPage(addr,(Bit8u)(val&0xff));
+		UserROMarkDirty(addr);
 		host_writeb(get_tlb_read(addr)+addr,(Bit8u)(val&0xff));
 	}
 	void writew(PhysPt addr,Bitu val) {
 		InitPage(addr,(Bit16u)(val&0xffff));
+		UserROMarkDirty(addr);
 		host_writew(get_tlb_read(addr)+addr,(Bit16u)(val&0xffff));
 	}
 	void writed(PhysPt addr,Bitu val) {
 		InitPage(addr,(Bit32u)val);
+		UserROMarkDirty(addr);
 		host_writed(get_tlb_read(addr)+addr,(Bit32u)val);
 	}
 	bool writeb_checked(PhysPt addr,Bitu val) {
 		Bitu writecode=InitPageCheckOnly(addr,(Bit8u)(val&0xff));
 		if (writecode) {
-			HostPt tlb_addr;
-			if (writecode>1) tlb_addr=get_tlb_read(addr);
-			else tlb_addr=get_tlb_write(addr);
-			host_writeb(tlb_addr+addr,(Bit8u)(val&0xff));
+			if (writecode>1) {
+				UserROMarkDirty(addr);
+				host_writeb(get_tlb_read(addr)+addr,(Bit8u)(val&0xff));
+			} else {
+				// linked writable, a clean page still traps its first write
+				mem_writeb_inline(addr,(Bit8u)(val&0xff));
+			}
 			return false;
 		}
 		return true;
@@ -501,10 +516,13 @@ public:
 	bool writew_checked(PhysPt addr,Bitu val) {
 		Bitu writecode=InitPageCheckOnly(addr,(Bit16u)(val&0xffff));
 		if (writecode) {
-			HostPt tlb_addr;
-			if (writecode>1) tlb_addr=get_tlb_read(addr);
-			else tlb_addr=get_tlb_write(addr);
-			host_writew(tlb_addr+addr,(Bit16u)(val&0xffff));
+			if (writecode>1) {
+				UserROMarkDirty(addr);
+				host_writew(get_tlb_read(addr)+addr,(Bit16u)(val&0xffff));
+			} else {
+				// linked writable, a clean page still traps its first write
+				mem_writew_inline(addr,(Bit16u)(val&0xffff));
+			}
 			return false;
 		}
 		return true;
@@ -512,10 +530,13 @@ public:
 	bool writed_checked(PhysPt addr,Bitu val) {
 		Bitu writecode=InitPageCheckOnly(addr,(Bit32u)val);
 		if (writecode) {
-			HostPt tlb_addr;
-			if (writecode>1) tlb_addr=get_tlb_read(addr);
-			else tlb_addr=get_tlb_write(addr);
-			host_writed(tlb_addr+addr,(Bit32u)val);
+			if (writecode>1) {
+				UserROMarkDirty(addr);
+				host_writed(get_tlb_read(addr)+addr,(Bit32u)val);
+			} else {
+				// linked writable, a clean page still traps its first write
+				mem_writed_inline(addr,(Bit32u)val);
+			}
 			return false;
 		}
 		return true;
@@ -643,34 +664,33 @@ bool PAGING_ForcePageInit(Bitu lin_addr) {
 }
 
 #if defined(USE_FULL_TLB)
+PageHandler * const paging_init_handler=&init_page_handler;
+
+static INLINE void ClearTLBEntry(Bitu lin_page) {
+	tlb_entry *entry=&paging.tlb.entries[lin_page];
+	entry->read=0;
+	entry->write=0;
+	entry->readhandler=0;
+	entry->writehandler=0;
+}
+
 void PAGING_InitTLB(void) {
-	for (Bitu i=0;i<TLB_SIZE;i++) {
-		paging.tlb.read[i]=0;
-		paging.tlb.write[i]=0;
-		paging.tlb.readhandler[i]=&init_page_handler;
-		paging.tlb.writehandler[i]=&init_page_handler;
-	}
-	paging.links.used=0;
+	/* Entries start out zeroed in bss and only linked pages are ever
+	   set, clearing those is enough and keeps the rest unpopulated */
+	PAGING_ClearTLB();
 }
 
 void PAGING_ClearTLB(void) {
 	Bit32u * entries=&paging.links.entries[0];
 	for (;paging.links.used>0;paging.links.used--) {
-		Bitu page=*entries++;
-		paging.tlb.read[page]=0;
-		paging.tlb.write[page]=0;
-		paging.tlb.readhandler[page]=&init_page_handler;
-		paging.tlb.writehandler[page]=&init_page_handler;
+		ClearTLBEntry(*entries++);
 	}
 	paging.links.used=0;
 }
 
 void PAGING_UnlinkPages(Bitu lin_page,Bitu pages) {
 	for (;pages>0;pages--) {
-		paging.tlb.read[lin_page]=0;
-		paging.tlb.write[lin_page]=0;
-		paging.tlb.readhandler[lin_page]=&init_page_handler;
-		paging.tlb.writehandler[lin_page]=&init_page_handler;
+		ClearTLBEntry(lin_page);
 		lin_page++;
 	}
 }
@@ -678,10 +698,7 @@ void PAGING_UnlinkPages(Bitu lin_page,Bitu pages) {
 void PAGING_MapPage(Bitu lin_page,Bitu phys_page) {
 	if (lin_page<LINK_START) {
 		paging.firstmb[lin_page]=phys_page;
-		paging.tlb.read[lin_page]=0;
-		paging.tlb.write[lin_page]=0;
-		paging.tlb.readhandler[lin_page]=&init_page_handler;
-		paging.tlb.writehandler[lin_page]=&init_page_handler;
+		ClearTLBEntry(lin_page);
 	} else {
 		PAGING_LinkPage(lin_page,phys_page);
 	}
@@ -699,15 +716,16 @@ void PAGING_LinkPage(Bitu lin_page,Bitu phys_page) {
 		assert(paging.links.used == 0);
 	}
 
+	tlb_entry *entry=&paging.tlb.entries[lin_page];
 	paging.tlb.phys_page[lin_page]=phys_page;
-	if (handler->flags & PFLAG_READABLE) paging.tlb.read[lin_page]=handler->GetHostReadPt(phys_page)-lin_base;
-	else paging.tlb.read[lin_page]=0;
-	if (handler->flags & PFLAG_WRITEABLE) paging.tlb.write[lin_page]=handler->GetHostWritePt(phys_page)-lin_base;
-	else paging.tlb.write[lin_page]=0;
+	if (handler->flags & PFLAG_READABLE) entry->read=handler->GetHostReadPt(phys_page)-lin_base;
+	else entry->read=0;
+	if ((handler->flags & PFLAG_WRITEABLE) && !MEM_PageWriteTrapped(phys_page)) entry->write=handler->GetHostWritePt(phys_page)-lin_base;
+	else entry->write=0;
 
 	paging.links.entries[paging.links.used++]=lin_page;
-	paging.tlb.readhandler[lin_page]=handler;
-	paging.tlb.writehandler[lin_page]=handler;
+	entry->readhandler=handler;
+	entry->writehandler=handler;
 }
 
 void PAGING_LinkPage_ReadOnly(Bitu lin_page,Bitu phys_page) {
@@ -722,14 +740,15 @@ void PAGING_LinkPage_ReadOnly(Bitu lin_page,Bitu phys_page) {
 		assert(paging.links.used == 0);
 	}
 
+	tlb_entry *entry=&paging.tlb.entries[lin_page];
 	paging.tlb.phys_page[lin_page]=phys_page;
-	if (handler->flags & PFLAG_READABLE) paging.tlb.read[lin_page]=handler->GetHostReadPt(phys_page)-lin_base;
-	else paging.tlb.read[lin_page]=0;
-	paging.tlb.write[lin_page]=0;
+	if (handler->flags & PFLAG_READABLE) entry->read=handler->GetHostReadPt(phys_page)-lin_base;
+	else entry->read=0;
+	entry->write=0;
 
 	paging.links.entries[paging.links.used++]=lin_page;
-	paging.tlb.readhandler[lin_page]=handler;
-	paging.tlb.writehandler[lin_page]=&init_page_handler_userro;
+	entry->readhandler=handler;
+	entry->writehandler=&init_page_handler_userro;
 }
 
 #else
@@ -805,7 +824,7 @@ void PAGING_LinkPage(Bitu lin_page,Bitu phys_page) {
 	entry->phys_page=phys_page;
 	if (handler->flags & PFLAG_READABLE) entry->read=handler->GetHostReadPt(phys_page)-lin_base;
 	else entry->read=0;
-	if (handler->flags & PFLAG_WRITEABLE) entry->write=handler->GetHostWritePt(phys_page)-lin_base;
+	if ((handler->flags & PFLAG_WRITEABLE) && !MEM_PageWriteTrapped(phys_page)) entry->write=handler->GetHostWritePt(phys_page)-lin_base;
 	else entry->write=0;
 
  	paging.links.entries[paging.links.used++]=lin_page;
@@ -838,7 +857,94 @@ void PAGING_LinkPage_ReadOnly(Bitu lin_page,Bitu phys_page) {
 #endif
 
 
+/* Translations of a page directory that was switched away from are kept
+   in a few contexts tagged with the directory page. When that directory
+   is loaded again the pages are linked right away instead of going
+   through the init handler one by one. Only pages that are present,
+   user accessible, writable, accessed and dirty on both levels are kept:
+   the init handler links those without any further checks or page table
+   updates. Each kept entry is compared with the page table in guest
+   memory again before it is reused, so page table writes while the
+   directory was inactive are honored. */
+#define TLB_CONTEXTS		8
+#define TLB_CONTEXT_PAGES	1024
+
+#define TLB_CONTEXT_KEEP	0x67	// present, writable, user, accessed, dirty
+
+static struct {
+	struct {
+		bool used;
+		Bitu dir_page;
+		Bitu last_use;
+		Bitu count;
+		struct {
+			Bit32u lin_page;
+			Bit32u entry;
+		} pages[TLB_CONTEXT_PAGES];
+	} ctx[TLB_CONTEXTS];
+	Bitu use_stamp;
+	struct {
+		Bitu hits,misses;
+		Bitu pages_restored,pages_dropped;
+	} stats;
+} tlb_contexts;
+
+static bool TLBContextEntry(Bitu dir_page,Bitu lin_page,X86PageEntry & entry) {
+	X86PageEntry table;
+	table.load=phys_readd((dir_page<<12)+(lin_page >> 10)*4);
+	if ((table.load & (TLB_CONTEXT_KEEP & ~0x40))!=(TLB_CONTEXT_KEEP & ~0x40)) return false;
+	entry.load=phys_readd((table.block.base<<12)+(lin_page & 0x3ff)*4);
+	return (entry.load & TLB_CONTEXT_KEEP)==TLB_CONTEXT_KEEP;
+}
+
+static void PAGING_SaveTLBContext(void) {
+	Bitu slot=0;
+	for (Bitu i=0;i<TLB_CONTEXTS;i++) {
+		if (tlb_contexts.ctx[i].used && tlb_contexts.ctx[i].dir_page==paging.base.page) {
+			slot=i;
+			break;
+		}
+		if (!tlb_contexts.ctx[i].used) slot=i;
+		else if (tlb_contexts.ctx[slot].used &&
+			tlb_contexts.ctx[i].last_use<tlb_contexts.ctx[slot].last_use) slot=i;
+	}
+	auto & ctx=tlb_contexts.ctx[slot];
+	ctx.used=true;
+	ctx.dir_page=paging.base.page;
+	ctx.last_use=++tlb_contexts.use_stamp;
+	ctx.count=0;
+	for (Bitu i=0;i<paging.links.used && ctx.count<TLB_CONTEXT_PAGES;i++) {
+		Bitu lin_page=paging.links.entries[i];
+		X86PageEntry entry;
+		if (!TLBContextEntry(ctx.dir_page,lin_page,entry)) continue;
+		if (entry.block.base!=(PAGING_GetPhysicalPage(lin_page<<12)>>12)) continue;
+		ctx.pages[ctx.count].lin_page=(Bit32u)lin_page;
+		ctx.pages[ctx.count].entry=entry.load;
+		ctx.count++;
+	}
+}
+
+static void PAGING_RestoreTLBContext(void) {
+	for (Bitu i=0;i<TLB_CONTEXTS;i++) {
+		auto & ctx=tlb_contexts.ctx[i];
+		if (!ctx.used || ctx.dir_page!=paging.base.page) continue;
+		tlb_contexts.stats.hits++;
+		ctx.last_use=++tlb_contexts.use_stamp;
+		for (Bitu p=0;p<ctx.count;p++) {
+			X86PageEntry entry;
+			Bitu lin_page=ctx.pages[p].lin_page;
+			if (TLBContextEntry(ctx.dir_page,lin_page,entry) && entry.load==ctx.pages[p].entry) {
+				PAGING_LinkPage(lin_page,entry.block.base);
+				tlb_contexts.stats.pages_restored++;
+			} else tlb_contexts.stats.pages_dropped++;
+		}
+		return;
+	}
+	tlb_contexts.stats.misses++;
+}
+
 void PAGING_SetDirBase(Bitu cr3) {
+	if (paging.enabled) PAGING_SaveTLBContext();
 	paging.cr3=cr3;
 	
 	paging.base.page=cr3 >> 12;
@@ -846,6 +952,7 @@ void PAGING_SetDirBase(Bitu cr3) {
 //	LOG(LOG_PAGING,LOG_NORMAL)("CR3:%X Base %X",cr3,paging.base.page);
 	if (paging.enabled) {
 		PAGING_ClearTLB();
+		PAGING_RestoreTLBContext();
 	}
 }
 
@@ -870,19 +977,44 @@ bool PAGING_Enabled(void) {
 	return paging.enabled;
 }
 
+static void PAGING_SaveState(SnapshotWriter &out) {
+	out.Write(static_cast<Bit32u>(paging.cr3));
+	out.Write(static_cast<Bit32u>(paging.cr2));
+	out.Write(paging.enabled);
+}
+
+static bool PAGING_LoadState(SnapshotReader &in,bool apply) {
+	Bit32u cr3,cr2;
+	bool enabled;
+	if (!in.Read(cr3) || !in.Read(cr2) || !in.Read(enabled)) return false;
+	if (!apply) return true;
+	PAGING_Enable(false);
+	PAGING_SetDirBase(cr3);
+	paging.cr2=cr2;
+	PAGING_Enable(enabled);
+	return true;
+}
+
 class PAGING:public Module_base{
 public:
 	PAGING(Section* configuration):Module_base(configuration){
 		/* Setup default Page Directory, force it to update */
 		paging.enabled=false;
 		PAGING_InitTLB();
+		for (auto & ctx : tlb_contexts.ctx) ctx.used=false;
 		Bitu i;
 		for (i=0;i<LINK_START;i++) {
 			paging.firstmb[i]=i;
 		}
 		pf_queue.used=0;
+		SNAPSHOT_Register("paging",1,PAGING_SaveState,PAGING_LoadState);
+	}
+	~PAGING(){
+		Bitu switches=tlb_contexts.stats.hits+tlb_contexts.stats.misses;
+		if (switches) LOG(LOG_PAGING,LOG_NORMAL)("TLB contexts: %u of %u directory loads hit, %u pages restored, %u dropped",
+			(unsigned)tlb_contexts.stats.hits,(unsigned)switches,
+			(unsigned)tlb_contexts.stats.pages_restored,(unsigned)tlb_contexts.stats.pages_dropped);
 	}
-	~PAGING(){}
 };
 
 static PAGING* test;
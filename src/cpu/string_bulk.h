@@ -0,0 +1,189 @@
+/*
+ *  Copyright (C) 2002-2020  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_STRING_BULK_H
+#define DOSBOX_STRING_BULK_H
+
+#include <cstring>
+
+#include "mem.h"
+#include "paging.h"
+
+/* Bulk execution of repeated string instructions. The cores call these in
+ * their element loops, each call does a run of elements that stays inside
+ * one page on every side and has host pointers for it (or a destination
+ * handler that takes blocks), and returns how many elements were done. A
+ * return of 0 means the next element has to go through the regular memory
+ * functions (other MMIO, pages that aren't linked yet or hold translated
+ * code, page crossing elements), after which the core can try again.
+ * Index and count updates are left to the caller, so an interruption
+ * between two runs leaves the registers exactly where the element loop
+ * would have left them. */
+
+/* Elements of abs(add_index) bytes from index on that can be done as one
+ * run: they don't cross a page and don't wrap around add_mask */
+static INLINE Bitu StringBulkRun(PhysPt base,Bitu index,Bitu add_mask,Bits add_index,Bitu count) {
+	const Bitu size=(add_index<0) ? (Bitu)-add_index : (Bitu)add_index;
+	const Bitu offset=(base+index) & (MEM_PAGE_SIZE-1);
+	if (offset+size>MEM_PAGE_SIZE || add_mask-index<size-1) return 0;
+	Bitu run,wrap;
+	if (add_index>0) {
+		run=(MEM_PAGE_SIZE-offset)/size;
+		wrap=(add_mask-index-(size-1))/size+1;
+	} else {
+		run=offset/size+1;
+		wrap=index/size+1;
+	}
+	if (run>wrap) run=wrap;
+	return (run>count) ? count : run;
+}
+
+/* Lowest host address of a run, the first element is the highest one when
+ * going down */
+static INLINE HostPt StringBulkLow(HostPt first,Bits add_index,Bitu run) {
+	return (add_index>0) ? first : first+add_index*(Bits)(run-1);
+}
+
+static INLINE Bit32u StringBulkRead(const Bit8u * host,Bitu size) {
+	switch (size) {
+	case 1: return host_readb(host);
+	case 2: return host_readw(host);
+	default: return host_readd(host);
+	}
+}
+
+static INLINE Bitu StringBulkMovs(PhysPt si_base,Bitu si_index,PhysPt di_base,Bitu di_index,
+                                  Bitu add_mask,Bits add_index,Bitu count) {
+	if (count<2) return 0;
+	Bitu run=StringBulkRun(si_base,si_index,add_mask,add_index,count);
+	run=StringBulkRun(di_base,di_index,add_mask,add_index,run);
+	if (!run) return 0;
+	const PhysPt si_addr=si_base+si_index;
+	const PhysPt di_addr=di_base+di_index;
+	HostPt src=get_tlb_read(si_addr);
+	if (!src) return 0;
+	src=StringBulkLow(src+si_addr,add_index,run);
+	const Bitu len=run*((add_index<0) ? -add_index : add_index);
+	HostPt dst=get_tlb_write(di_addr);
+	if (!dst) {
+		/* Handlers like planar vga memory can still take the whole run */
+		PageHandler * handler=get_tlb_writehandler(di_addr);
+		if (!(handler->flags & PFLAG_WRITEBLOCK)) return 0;
+		const PhysPt di_low=(add_index>0) ? di_addr : di_addr+add_index*(Bits)(run-1);
+		return handler->writeblock(di_low,src,len) ? run : 0;
+	}
+	dst=StringBulkLow(dst+di_addr,add_index,run);
+	/* Overlapping copies towards the not yet read source repeat a pattern,
+	   that's left to the element loop */
+	if ((add_index>0) ? (dst>src && dst<src+len) : (dst<src && dst+len>src)) return 0;
+	memmove(dst,src,len);
+	return run;
+}
+
+static INLINE void StringBulkFill(HostPt dst,Bits add_index,Bitu run,Bit32u val) {
+	switch (add_index) {
+	case 1: case -1:
+		memset(dst,(Bit8u)val,run);
+		break;
+	case 2: case -2:
+		for (Bitu i=0;i<run;i++) host_writew(dst+i*2,(Bit16u)val);
+		break;
+	default:
+		for (Bitu i=0;i<run;i++) host_writed(dst+i*4,val);
+		break;
+	}
+}
+
+static INLINE Bitu StringBulkStos(PhysPt di_base,Bitu di_index,Bitu add_mask,Bits add_index,
+                                  Bitu count,Bit32u val) {
+	if (count<2) return 0;
+	const Bitu run=StringBulkRun(di_base,di_index,add_mask,add_index,count);
+	if (!run) return 0;
+	const PhysPt di_addr=di_base+di_index;
+	HostPt dst=get_tlb_write(di_addr);
+	if (!dst) {
+		PageHandler * handler=get_tlb_writehandler(di_addr);
+		if (!(handler->flags & PFLAG_WRITEBLOCK)) return 0;
+		const PhysPt di_low=(add_index>0) ? di_addr : di_addr+add_index*(Bits)(run-1);
+		Bit8u block[MEM_PAGE_SIZE];
+		StringBulkFill(block,add_index,run,val);
+		return handler->writeblock(di_low,block,run*((add_index<0) ? -add_index : add_index)) ? run : 0;
+	}
+	StringBulkFill(StringBulkLow(dst+di_addr,add_index,run),add_index,run,val);
+	return run;
+}
+
+/* last gets the last element compared, the caller finds out from it
+ * whether the run ended on the terminating element */
+static INLINE Bitu StringBulkScas(PhysPt di_base,Bitu di_index,Bitu add_mask,Bits add_index,
+                                  Bitu count,Bit32u val,bool rep_zero,Bit32u & last) {
+	if (count<2) return 0;
+	const Bitu run=StringBulkRun(di_base,di_index,add_mask,add_index,count);
+	if (!run) return 0;
+	const PhysPt di_addr=di_base+di_index;
+	HostPt host=get_tlb_read(di_addr);
+	if (!host) return 0;
+	host+=di_addr;
+	if (add_index==1 && !rep_zero) {
+		/* repne scasb, the strlen/strchr case */
+		const Bit8u * found=static_cast<const Bit8u *>(memchr(host,(Bit8u)val,run));
+		if (!found) {
+			last=host_readb(host+run-1);
+			return run;
+		}
+		last=(Bit8u)val;
+		return (Bitu)(found-host)+1;
+	}
+	const Bitu size=(add_index<0) ? (Bitu)-add_index : (Bitu)add_index;
+	for (Bitu i=0;i<run;i++,host+=add_index) {
+		last=StringBulkRead(host,size);
+		if ((last==val)!=rep_zero) return i+1;
+	}
+	return run;
+}
+
+static INLINE Bitu StringBulkCmps(PhysPt si_base,Bitu si_index,PhysPt di_base,Bitu di_index,
+                                  Bitu add_mask,Bits add_index,Bitu count,bool rep_zero,
+                                  Bit32u & val1,Bit32u & val2) {
+	if (count<2) return 0;
+	Bitu run=StringBulkRun(si_base,si_index,add_mask,add_index,count);
+	run=StringBulkRun(di_base,di_index,add_mask,add_index,run);
+	if (!run) return 0;
+	const PhysPt si_addr=si_base+si_index;
+	const PhysPt di_addr=di_base+di_index;
+	HostPt src=get_tlb_read(si_addr);
+	HostPt dst=get_tlb_read(di_addr);
+	if (!src || !dst) return 0;
+	src+=si_addr;
+	dst+=di_addr;
+	const Bitu size=(add_index<0) ? (Bitu)-add_index : (Bitu)add_index;
+	if (rep_zero && memcmp(StringBulkLow(src,add_index,run),
+	                       StringBulkLow(dst,add_index,run),run*size)==0) {
+		/* repe cmps over equal blocks runs to the end */
+		val1=val2=StringBulkRead(src+add_index*(Bits)(run-1),size);
+		return run;
+	}
+	for (Bitu i=0;i<run;i++,src+=add_index,dst+=add_index) {
+		val1=StringBulkRead(src,size);
+		val2=StringBulkRead(dst,size);
+		if ((val1==val2)!=rep_zero) return i+1;
+	}
+	return run;
+}
+
+#endif
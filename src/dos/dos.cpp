@@ -29,6 +29,7 @@
 #include "setup.h"
 #include "support.h"
 #include "serialport.h"
+#include "snapshot.h"
 
 DOS_Block dos;
 DOS_InfoBlock dos_infoblock;
@@ -1247,6 +1248,128 @@ DOS_Version DOS_ParseVersion(const char *word, const char *args)
 	return new_version;
 }
 
+/* The dos tables in guest memory are part of the memory record. Open files
+ * are saved by name and position and opened again on load, the contents of
+ * the files on the mounted drives are not part of the snapshot. */
+enum {DOS_SNAPSHOT_FILE,DOS_SNAPSHOT_DEVICE,DOS_SNAPSHOT_NONE};
+
+static Bit32u DOS_MountedDrives(void) {
+	Bit32u mask=0;
+	for (Bitu i=0;i<DOS_DRIVES;i++) {
+		if (Drives[i]) mask|=1u << i;
+	}
+	return mask;
+}
+
+static void DOS_SaveState(SnapshotWriter &out) {
+	out.Write(static_cast<Bit32u>(sizeof(DOS_Block)));
+	out.Write(&dos,sizeof(DOS_Block));
+	out.Write(DOS_GetMemAllocStrategy());
+	out.Write(DOS_MountedDrives());
+	for (Bitu i=0;i<DOS_DRIVES;i++) {
+		if (Drives[i]) out.Write(Drives[i]->curdir,sizeof(Drives[i]->curdir));
+	}
+	for (Bitu i=0;i<DOS_FILES;i++) {
+		DOS_File * file=Files[i];
+		const DOS_Device * device=dynamic_cast<DOS_Device *>(file);
+		if (!file || (!device && file->GetDrive()>=DOS_DRIVES)) {
+			if (file) LOG_MSG("DOS: Open file %s is not part of the snapshot",file->GetName());
+			out.Write(static_cast<Bit8u>(DOS_SNAPSHOT_NONE));
+			continue;
+		}
+		out.Write(static_cast<Bit8u>(device ? DOS_SNAPSHOT_DEVICE : DOS_SNAPSHOT_FILE));
+		out.Write(static_cast<Bit8u>(device ? device->GetDeviceNumber() : file->GetDrive()));
+		const std::string & name=file->name;
+		out.Write(static_cast<Bit16u>(name.size()));
+		out.Write(name.data(),name.size());
+		Bit32u pos=0;
+		if (!device && file->IsOpen()) file->Seek(&pos,DOS_SEEK_CUR);
+		out.Write(pos);
+		out.Write(file->flags);
+		out.Write(file->attr);
+		out.Write(file->time);
+		out.Write(file->date);
+		out.Write(static_cast<Bit32s>(file->refCtr));
+		out.Write(file->IsOpen());
+	}
+}
+
+static bool DOS_LoadState(SnapshotReader &in,bool apply) {
+	Bit32u size,drives;
+	Bit16u strategy;
+	if (!in.Read(size) || size!=sizeof(DOS_Block)) return false;
+	DOS_Block saved;
+	if (!in.Read(&saved,sizeof(DOS_Block)) || !in.Read(strategy) || !in.Read(drives)) return false;
+	if (drives!=DOS_MountedDrives()) {
+		LOG_MSG("DOS: Snapshot was taken with other drives mounted");
+		return false;
+	}
+	for (Bitu i=0;i<DOS_DRIVES;i++) {
+		if (!Drives[i]) continue;
+		char curdir[DOS_PATHLENGTH];
+		if (!in.Read(curdir)) return false;
+		curdir[DOS_PATHLENGTH-1]=0;
+		if (apply) safe_strcpy(Drives[i]->curdir,curdir);
+	}
+	if (apply) {
+		Bit8u * country=dos.tables.country;
+		memcpy(&dos,&saved,sizeof(DOS_Block));
+		dos.tables.country=country;
+		DOS_SetMemAllocStrategy(strategy);
+		for (Bitu i=0;i<DOS_FILES;i++) {
+			if (!Files[i]) continue;
+			if (Files[i]->IsOpen()) Files[i]->Close();
+			delete Files[i];
+			Files[i]=0;
+		}
+	}
+	for (Bitu i=0;i<DOS_FILES;i++) {
+		Bit8u type,number;
+		Bit16u length;
+		if (!in.Read(type)) return false;
+		if (type==DOS_SNAPSHOT_NONE) continue;
+		if (type>DOS_SNAPSHOT_DEVICE || !in.Read(number) || !in.Read(length) || length>=DOS_PATHLENGTH) return false;
+		char name[DOS_PATHLENGTH];
+		Bit32u pos,flags;
+		Bit16u attr,time,date;
+		Bit32s refs;
+		bool open;
+		if (!in.Read(name,length) || !in.Read(pos) || !in.Read(flags) || !in.Read(attr) ||
+			!in.Read(time) || !in.Read(date) || !in.Read(refs) || !in.Read(open)) return false;
+		name[length]=0;
+		DOS_File * file=0;
+		if (type==DOS_SNAPSHOT_DEVICE) {
+			if (number>=DOS_DEVICES || !Devices[number] || !Devices[number]->IsName(name)) {
+				LOG_MSG("DOS: Snapshot has a handle to device %s, which this configuration lacks",name);
+				return false;
+			}
+			if (!apply) continue;
+			file=new DOS_Device(*Devices[number]);
+		} else {
+			if (number>=DOS_DRIVES || !Drives[number] || !Drives[number]->FileOpen(&file,name,flags)) {
+				LOG_MSG("DOS: Can't open %c:\\%s again for the snapshot",'A'+number,name);
+				if (apply) continue;	// gone since the check
+				return false;
+			}
+			if (!apply) {
+				file->Close();
+				delete file;
+				continue;
+			}
+			file->SetDrive(number);
+			file->Seek(&pos,DOS_SEEK_SET);
+			file->flags=flags;
+			file->attr=attr;
+			file->time=time;
+			file->date=date;
+			if (!open) file->Close();
+		}
+		file->refCtr=refs;
+		Files[i]=file;
+	}
+	return true;
+}
+
 class DOS:public Module_base{
 private:
 	CALLBACK_HandlerObject callback[7];
@@ -1306,8 +1429,10 @@ public:
 			dos.version.major = new_version.major;
 			dos.version.minor = new_version.minor;
 		}
+		SNAPSHOT_Register("dos",1,DOS_SaveState,DOS_LoadState);
 	}
 	~DOS(){
+		SNAPSHOT_Unregister("dos");
 		for (Bit16u i=0;i<DOS_DRIVES;i++) delete Drives[i];
 	}
 };
@@ -40,6 +40,7 @@
 #include "dma.h"
 #include "shell.h"
 #include "program_autotype.h"
+#include "program_clone.h"
 
 #if defined(WIN32)
 #ifndef S_ISDIR
@@ -1785,6 +1786,7 @@ void DOS_SetupPrograms(void) {
 
 	/*regular setup*/
 	PROGRAMS_MakeFile("AUTOTYPE.COM", AUTOTYPE_ProgramStart);
+	PROGRAMS_MakeFile("CLONE.COM", CLONE_ProgramStart);
 	PROGRAMS_MakeFile("MOUNT.COM",MOUNT_ProgramStart);
 	PROGRAMS_MakeFile("MEM.COM",MEM_ProgramStart);
 	PROGRAMS_MakeFile("LOADFIX.COM",LOADFIX_ProgramStart);
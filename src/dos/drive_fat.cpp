@@ -83,7 +83,7 @@ static void convToDirFile(char *filename, char *filearray) {
 	}
 }
 
-fatFile::fatFile(const char* /*name*/,
+fatFile::fatFile(const char* name,
                  Bit32u startCluster,
                  Bit32u fileLen,
                  fatDrive *useDrive)
@@ -100,6 +100,7 @@ fatFile::fatFile(const char* /*name*/,
 {
 	Bit32u seekto = 0;
 	open = true;
+	SetName(name);
 	if(filelength > 0) {
 		Seek(&seekto, DOS_SEEK_SET);
 	}
@@ -148,6 +148,7 @@ bool Virtual_Drive::FileOpen(DOS_File * * file,char * name,Bit32u flags) {
 		/* We have a match */
 			*file=new Virtual_File(cur_file->data,cur_file->size);
 			(*file)->flags=flags;
+			(*file)->SetName(cur_file->name);
 			return true;
 		}
 		cur_file=cur_file->next;
@@ -0,0 +1,174 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2020-2020  The dosbox-staging team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "dosbox.h"
+
+#include <cstdlib>
+#include <string>
+
+#if defined(HAVE_FORK)
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "callback.h"
+#include "control.h"
+#include "midi.h"
+#include "programs.h"
+#include "setup.h"
+#include "shell.h"
+#include "video.h"
+#include "program_clone.h"
+
+#if defined(HAVE_FORK)
+constexpr int max_clones = 64;
+
+// Programs get a copy of the environment, the shell's one has to be changed
+static void SetCloneEnv(int clone)
+{
+	if (first_shell)
+		first_shell->SetEnv("CLONE", std::to_string(clone).c_str());
+}
+
+// Why this process can't be forked, nullptr when it can. The copies would
+// share the display connection, the audio thread, MIDI devices and sockets.
+static const char *CloneBlocker()
+{
+	if (!GFX_IsHeadless())
+		return "a display is in use, run with SDL_VIDEODRIVER=dummy";
+	const Section_prop *mixer = static_cast<Section_prop *>(
+	        control->GetSection("mixer"));
+	if (mixer && !mixer->Get_bool("nosound"))
+		return "sound output can't be shared, set nosound=true";
+	if (MIDI_DeviceOpen())
+		return "a MIDI device is open, set mididevice=none";
+	const Section_prop *serial = static_cast<Section_prop *>(
+	        control->GetSection("serial"));
+	if (serial) {
+		char property[] = "serialx";
+		for (char port = '1'; port <= '4'; port++) {
+			property[6] = port;
+			const std::string type = serial->Get_multival(property)
+			                                 ->GetSection()
+			                                 ->Get_string("type");
+			if (type != "dummy" && type != "disabled")
+				return "serial ports have to be dummy or disabled";
+		}
+	}
+	const Section_prop *ipx = static_cast<Section_prop *>(
+	        control->GetSection("ipx"));
+	if (ipx && ipx->Get_bool("ipx"))
+		return "IPX networking can't be shared, set ipx=false";
+	return nullptr;
+}
+#endif
+
+void CLONE::PrintUsage()
+{
+	constexpr const char *msg =
+	        "\033[32;1mCLONE\033[0m count\n\n"
+	        "Forks count copies of the running DOSBox process. The copies "
+	        "share the\n"
+	        "emulated memory, the translated code and the drive caches "
+	        "copy-on-write\n"
+	        "and continue independently from this point on.\n"
+	        "\n"
+	        "  Each copy sets the CLONE environment variable to its number "
+	        "(1 to count).\n"
+	        "  The original sets it to 0 once all copies have exited.\n"
+	        "\n"
+	        "  Only works in headless template instances: the SDL video "
+	        "driver has to be\n"
+	        "  dummy or offscreen, sound disabled (nosound=true), with no "
+	        "MIDI device,\n"
+	        "  serial port device or IPX. Files opened by the DOS program at "
+	        "this point\n"
+	        "  are shared between all copies.\n"
+	        "\n"
+	        "Example AUTOEXEC section:\n"
+	        "  \033[32;1mCLONE\033[0m 8\n"
+	        "  if \"%CLONE%\"==\"0\" exit\n"
+	        "  job%CLONE%.bat\n";
+	WriteOut_NoParsing(msg);
+}
+
+void CLONE::Run()
+{
+	std::string arg;
+	if (!cmd->FindCommand(1, arg)) {
+		PrintUsage();
+		return;
+	}
+#if defined(HAVE_FORK)
+	const int count = atoi(arg.c_str());
+	if (count < 1 || count > max_clones) {
+		WriteOut("CLONE: count has to be between 1 and %d\n", max_clones);
+		return;
+	}
+	const char *blocker = CloneBlocker();
+	if (blocker) {
+		WriteOut("CLONE: %s\n", blocker);
+		return;
+	}
+
+	int started = 0;
+	for (int clone = 1; clone <= count; clone++) {
+		const pid_t pid = fork();
+		if (pid == 0) {
+			// The copy continues the emulation on its own
+			SetCloneEnv(clone);
+			return;
+		}
+		if (pid < 0) {
+			WriteOut("CLONE: could only start %d of %d copies\n",
+			         started, count);
+			break;
+		}
+		started++;
+	}
+
+	// Keep the emulation (and so the event handling) going while waiting
+	int failed = 0;
+	while (started > 0) {
+		int status = 0;
+		const pid_t pid = waitpid(-1, &status, WNOHANG);
+		if (pid < 0)
+			break;
+		if (pid == 0) {
+			CALLBACK_Idle();
+			continue;
+		}
+		started--;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			failed++;
+	}
+	if (failed)
+		WriteOut("CLONE: %d copies did not exit cleanly\n", failed);
+	SetCloneEnv(0);
+#else
+	WriteOut_NoParsing("CLONE: not supported on this platform\n");
+#endif
+}
+
+void CLONE_ProgramStart(Program **make)
+{
+	*make = new CLONE;
+}
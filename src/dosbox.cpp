@@ -22,6 +22,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+
+#include <chrono>
+
 #include "dosbox.h"
 #include "debug.h"
 #include "cpu.h"
@@ -44,6 +47,8 @@
 #include "pci_bus.h"
 #include "midi.h"
 #include "hardware.h"
+#include "snapshot.h"
+#include "auto_cycles.h"
 
 Config * control;
 MachineType machine;
@@ -148,6 +153,7 @@ static Bitu Normal_Loop(void) {
 #endif
 		} else {
 			GFX_Events();
+			SNAPSHOT_RunPending();
 			if (ticksRemain>0) {
 				TIMER_AddTick();
 				ticksRemain--;
@@ -159,6 +165,19 @@ static Bitu Normal_Loop(void) {
 //For trying other delays
 #define wrap_delay(a) SDL_Delay(a)
 
+/* A guest waiting in HLT can't do anything before the next event or host
+ * input, so the host sleeps up to that event instead of polling every
+ * millisecond. The limit keeps input latency low and stays well inside
+ * the mixer prebuffer. */
+#define IDLE_SLEEP_MAX 10
+
+static Bit32u IdleSleepTime(void) {
+	if (!CPU_IsHalted()) return 0;
+	double delay;
+	if (!PIC_NextEventDelay(delay) || delay>IDLE_SLEEP_MAX) return IDLE_SLEEP_MAX;
+	return (delay<1.0) ? 0 : (Bit32u)delay;
+}
+
 void increaseticks() { //Make it return ticksRemain and set it in the function above to remove the global variable.
 	if (GCC_UNLIKELY(ticksLocked)) { // For Fast Forward Mode
 		ticksRemain=5;
@@ -167,6 +186,7 @@ void increaseticks() { //Make it return ticksRemain and set it in the function a
 		ticksAdded = 0;
 		ticksDone = 0;
 		ticksScheduled = 0;
+		AUTOCYCLES_Reset();
 		return;
 	}
 	
@@ -176,10 +196,15 @@ void increaseticks() { //Make it return ticksRemain and set it in the function a
 	Bit32u ticksNew;
 	ticksNew = GetTicks();
 	ticksScheduled += ticksAdded;
+	AUTOCYCLES_AddTicks(ticksAdded);
 	if (ticksNew <= ticksLast) { //lower should not be possible, only equal.
 		ticksAdded = 0;
 
-		if (!CPU_CycleAutoAdjust || CPU_SkipCycleAutoAdjust || sleep1count < 3) {
+		const auto sleep_start = std::chrono::steady_clock::now();
+		const Bit32u idle_sleep = IdleSleepTime();
+		if (idle_sleep > 1) {
+			wrap_delay(idle_sleep);
+		} else if (!CPU_CycleAutoAdjust || CPU_SkipCycleAutoAdjust || sleep1count < 3) {
 			wrap_delay(1);
 		} else {
 			/* Certain configurations always give an exact sleepingtime of 1, this causes problems due to the fact that
@@ -192,6 +217,8 @@ void increaseticks() { //Make it return ticksRemain and set it in the function a
 			wrap_delay(sleeppattern[sleepindex++]);
 			sleepindex %= sizeof(sleeppattern) / sizeof(sleeppattern[0]);
 		}
+		AUTOCYCLES_AddSleep(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		        std::chrono::steady_clock::now() - sleep_start).count());
 		Bit32s timeslept = GetTicks() - ticksNew;
 		// Count how many times in the current block (of 250 ms) the time slept was 1 ms
 		if (CPU_CycleAutoAdjust && !CPU_SkipCycleAutoAdjust && timeslept == 1) sleep1count++;
@@ -216,6 +243,7 @@ void increaseticks() { //Make it return ticksRemain and set it in the function a
 	ticksRemain = ticksNew-ticksLast;
 	ticksLast = ticksNew;
 	ticksDone += ticksRemain;
+	const bool lagging = ticksRemain > 15;
 	if ( ticksRemain > 20 ) {
 //		LOG(LOG_MISC,LOG_ERROR)("large remain %d",ticksRemain);
 		ticksRemain = 20;
@@ -223,89 +251,18 @@ void increaseticks() { //Make it return ticksRemain and set it in the function a
 	ticksAdded = ticksRemain;
 
 	// Is the system in auto cycle mode guessing ? If not just exit. (It can be temporary disabled)
-	if (!CPU_CycleAutoAdjust || CPU_SkipCycleAutoAdjust) return;
-	
-	if (ticksScheduled >= 250 || ticksDone >= 250 || (ticksAdded > 15 && ticksScheduled >= 5) ) {
-		if(ticksDone < 1) ticksDone = 1; // Protect against div by zero
-		/* ratio we are aiming for is around 90% usage*/
-		Bit32s ratio = (ticksScheduled * (CPU_CyclePercUsed*90*1024/100/100)) / ticksDone;
-		Bit32s new_cmax = CPU_CycleMax;
-		Bit64s cproc = (Bit64s)CPU_CycleMax * (Bit64s)ticksScheduled;
-		double ratioremoved = 0.0; //increase scope for logging
-		if (cproc > 0) {
-			/* ignore the cycles added due to the IO delay code in order
-			   to have smoother auto cycle adjustments */
-			ratioremoved = (double) CPU_IODelayRemoved / (double) cproc;
-			if (ratioremoved < 1.0) {
-				double ratio_not_removed = 1 - ratioremoved;
-				ratio = (Bit32s)((double)ratio * ratio_not_removed);
-
-				/* Don't allow very high ratio which can cause us to lock as we don't scale down
-				 * for very low ratios. High ratio might result because of timing resolution */
-				if (ticksScheduled >= 250 && ticksDone < 10 && ratio > 16384)
-					ratio = 16384;
-
-				// Limit the ratio even more when the cycles are already way above the realmode default.
-				if (ticksScheduled >= 250 && ticksDone < 10 && ratio > 5120 && CPU_CycleMax > 50000)
-					ratio = 5120;
-
-				// When downscaling multiple times in a row, ensure a minimum amount of downscaling
-				if (ticksAdded > 15 && ticksScheduled >= 5 && ticksScheduled <= 20 && ratio > 800)
-					ratio = 800;
-
-				if (ratio <= 1024) {
-					// ratio_not_removed = 1.0; //enabling this restores the old formula
-					double r = (1.0 + ratio_not_removed) /(ratio_not_removed + 1024.0/(static_cast<double>(ratio)));
-					new_cmax = 1 + static_cast<Bit32s>(CPU_CycleMax * r);
-				} else {
-					Bit64s ratio_with_removed = (Bit64s) ((((double)ratio - 1024.0) * ratio_not_removed) + 1024.0);
-					Bit64s cmax_scaled = (Bit64s)CPU_CycleMax * ratio_with_removed;
-					new_cmax = (Bit32s)(1 + (CPU_CycleMax >> 1) + cmax_scaled / (Bit64s)2048);
-				}
-			}
-		}
-
-		if (new_cmax < CPU_CYCLES_LOWER_LIMIT)
-			new_cmax = CPU_CYCLES_LOWER_LIMIT;
-		/*
-		LOG(LOG_MISC,LOG_ERROR)("cyclelog: current %06d   cmax %06d   ratio  %05d  done %03d   sched %03d Add %d rr %4.2f",
-			CPU_CycleMax,
-			new_cmax,
-			ratio,
-			ticksDone,
-			ticksScheduled,
-			ticksAdded,
-			ratioremoved);
-		*/
-
-		/* ratios below 1% are considered to be dropouts due to
-		   temporary load imbalance, the cycles adjusting is skipped */
-		if (ratio > 10) {
-			/* ratios below 12% along with a large time since the last update
-			   has taken place are most likely caused by heavy load through a
-			   different application, the cycles adjusting is skipped as well */
-			if ((ratio > 120) || (ticksDone < 700)) {
-				CPU_CycleMax = new_cmax;
-				if (CPU_CycleLimit > 0) {
-					if (CPU_CycleMax > CPU_CycleLimit) CPU_CycleMax = CPU_CycleLimit;
-				} else if (CPU_CycleMax > 2000000) CPU_CycleMax = 2000000; //Hardcoded limit, if no limit was specified.
-			}
-		}
+	if (!CPU_CycleAutoAdjust || CPU_SkipCycleAutoAdjust) {
+		AUTOCYCLES_Reset();
+		return;
+	}
 
-		//Reset cycleguessing parameters.
-		CPU_IODelayRemoved = 0;
+	if (AUTOCYCLES_Update(lagging)) {
+		//Reset the sleep pattern parameters along with the controller window.
 		ticksDone = 0;
 		ticksScheduled = 0;
 		lastsleepDone = -1;
 		sleep1count = 0;
-	} else if (ticksAdded > 15) {
-		/* ticksAdded > 15 but ticksScheduled < 5, lower the cycles
-		   but do not reset the scheduled/done ticks to take them into
-		   account during the next auto cycle adjustment */
-		CPU_CycleMax /= 3;
-		if (CPU_CycleMax < CPU_CYCLES_LOWER_LIMIT)
-			CPU_CycleMax = CPU_CYCLES_LOWER_LIMIT;
-	} //if (ticksScheduled >= 250 || ticksDone >= 250 || (ticksAdded > 15 && ticksScheduled >= 5) )
+	}
 }
 
 void DOSBOX_SetLoop(LoopHandler * handler) {
@@ -316,11 +273,19 @@ void DOSBOX_SetNormalLoop() {
 	loop=Normal_Loop;
 }
 
+static Bitu run_depth=0;
+
 void DOSBOX_RunMachine(void){
 	Bitu ret;
+	run_depth++;
 	do {
 		ret=(*loop)();
 	} while (!ret);
+	run_depth--;
+}
+
+Bitu DOSBOX_GetRunDepth(void) {
+	return run_depth;
 }
 
 static void DOSBOX_UnlockSpeed( bool pressed ) {
@@ -355,6 +320,7 @@ static void DOSBOX_RealInit(Section * sec) {
 	MSG_Init(section);
 
 	MAPPER_AddHandler(DOSBOX_UnlockSpeed, MK_f12, MMOD2,"speedlock","Speedlock");
+	SNAPSHOT_Init(section);
 	std::string cmd_machine;
 	if (control->cmdline->FindString("-machine",cmd_machine,true)){
 		//update value in config (else no matching against suggested values
@@ -422,6 +388,11 @@ void DOSBOX_Init(void) {
 	Pstring = secprop->Add_path("captures",Property::Changeable::Always,"capture");
 	Pstring->Set_help("Directory where things like wave, midi, screenshot get captured.");
 
+	Pstring = secprop->Add_path("snapshot",Property::Changeable::Always,"dosbox.snapshot");
+	Pstring->Set_help("File the save state hotkey (alt-f5) writes and the load state hotkey\n"
+	                  "(alt-f9) reads. It only loads with the same machine, memory, sound\n"
+	                  "card and drive configuration. Files on mounted drives aren't saved.");
+
 #if C_DEBUG
 	LOG_StartUp();
 #endif
@@ -437,6 +408,11 @@ void DOSBOX_Init(void) {
 		"This value is best left at its default to avoid problems with some games,\n"
 		"though few games might require a higher value.\n"
 		"There is generally no speed advantage when raising this value.");
+	Pbool = secprop->Add_bool("memhugepages", Property::Changeable::WhenIdle, false);
+	Pbool->Set_help(
+		"Ask the host to back the emulated memory with transparent huge pages.\n"
+		"Lowers host TLB pressure with large memsize values, only has an effect\n"
+		"on hosts that support it (Linux).");
 	secprop->AddInitFunction(&CALLBACK_Init);
 	secprop->AddInitFunction(&PIC_Init);//done
 	secprop->AddInitFunction(&PROGRAMS_Init);
@@ -540,6 +516,12 @@ void DOSBOX_Init(void) {
 
 	Pstring = Pmulti_remain->GetSection()->Add_string("parameters",Property::Changeable::Always,"");
 
+	Pstring = secprop->Add_path("cycles_telemetry",Property::Changeable::Always,"");
+	Pstring->Set_help("File that receives a CSV line for each decision of the auto/max cycles\n"
+	                  "controller: the measured host load, the target and the new cycles.\n"
+	                  "Leave empty to turn it off.");
+	secprop->AddInitFunction(&AUTOCYCLES_Init,true);
+
 	Pint = secprop->Add_int("cycleup",Property::Changeable::Always,10);
 	Pint->SetMinMax(1,1000000);
 	Pint->Set_help("Amount of cycles to decrease/increase with keycombos.(CTRL-F11/CTRL-F12)");
@@ -548,6 +530,31 @@ void DOSBOX_Init(void) {
 	Pint->SetMinMax(1,1000000);
 	Pint->Set_help("Setting it lower than 100 will be a percentage.");
 
+#if (C_DYNAMIC_X86) || (C_DYNREC)
+	Pint = secprop->Add_int("dynamic_cache_size", Property::Changeable::OnlyAtStart, 8);
+	Pint->SetMinMax(1, 512);
+	Pint->Set_help("Size of the dynamic core's code cache in MB. The number of cached code\n"
+	               "blocks and pages grows along with it. Large protected mode programs\n"
+	               "that keep retranslating their code can benefit from a bigger cache.");
+
+	Pbool = secprop->Add_bool("dynamic_cache_grow", Property::Changeable::OnlyAtStart, false);
+	Pbool->Set_help("Double the size of the dynamic core's code cache (up to 512 MB) whenever\n"
+	                "translated code has to be evicted too often.");
+#endif
+
+#if (C_DYNREC)
+	Pbool = secprop->Add_bool("dynamic_lazy_translation", Property::Changeable::OnlyAtStart, false);
+	Pbool->Set_help("Let the normal core run newly executed code for a while before the dynamic\n"
+	                "core translates it. Code that runs only a few times, like loaders, is never\n"
+	                "translated, which reduces hitches when a lot of new code is started.");
+
+	Pstring = secprop->Add_path("dynamic_hot_pages", Property::Changeable::OnlyAtStart, "");
+	Pstring->Set_help("File that keeps the guest code pages translated by the dynamic core along\n"
+	                  "with the start of their blocks. When a page is run again in a later session\n"
+	                  "and its contents are unchanged, all of its blocks are translated at once.\n"
+	                  "Leave empty to turn it off.");
+#endif
+
 #if C_FPU
 	secprop->AddInitFunction(&FPU_Init);
 #endif
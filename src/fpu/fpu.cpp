@@ -26,6 +26,7 @@
 #include "mem.h"
 #include "fpu.h"
 #include "cpu.h"
+#include "snapshot.h"
 
 FPU_rec fpu;
 
@@ -624,8 +625,20 @@ void FPU_ESC7_Normal(Bitu rm) {
 }
 
 
+static void FPU_SaveState(SnapshotWriter &out) {
+	out.Write(static_cast<Bit32u>(sizeof(fpu)));
+	out.Write(fpu);
+}
+
+static bool FPU_LoadState(SnapshotReader &in,bool apply) {
+	Bit32u size;
+	if (!in.Read(size) || size!=sizeof(fpu)) return false;
+	return apply ? in.Read(fpu) : in.Skip(size);
+}
+
 void FPU_Init(Section*) {
 	FPU_FINIT();
+	SNAPSHOT_Register("fpu",1,FPU_SaveState,FPU_LoadState);
 }
 
 #endif
@@ -2353,6 +2353,14 @@ bool GFX_IsFullscreen(void) {
 	return sdl.desktop.fullscreen;
 }
 
+// No display connection, the window only exists for SDL's sake
+bool GFX_IsHeadless(void)
+{
+	const char *driver = SDL_GetCurrentVideoDriver();
+	return driver && (strcmp(driver, "dummy") == 0 ||
+	                  strcmp(driver, "offscreen") == 0);
+}
+
 #if defined(MACOSX)
 #define DB_POLLSKIP 3
 #else
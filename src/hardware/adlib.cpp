@@ -25,6 +25,7 @@
 #include "setup.h"
 #include "mapper.h"
 #include "mem.h"
+#include "snapshot.h"
 #include "dbopl.h"
 #include "../libs/nuked/nukedopl.h"
 
@@ -719,10 +720,87 @@ void Module::Init( Mode m ) {
 	}
 }
 
+static bool IsKeyReg( Bit32u reg ) {
+	reg &= 0xff;
+	return ( reg >= 0xb0 && reg <= 0xb8 ) || reg == 0xbd;
+}
+
+void Module::SaveState( SnapshotWriter &out ) const {
+	out.Write( mode );
+	out.Write( reg );
+	out.Write( ctrl.active );
+	out.Write( ctrl.index );
+	out.Write( ctrl.lvol );
+	out.Write( ctrl.rvol );
+	out.Write( lastUsed );
+	out.Write( cache );
+	out.Write( static_cast<Bit32u>( sizeof( chip ) ) );
+	out.Write( chip );
+	out.Write( mixerChan->is_enabled );
+}
+
+bool Module::LoadState( SnapshotReader &in, bool apply ) {
+	Mode savedMode;
+	if ( !in.Read( savedMode ) ) 
+		return false;
+	if ( savedMode != mode ) {
+		LOG_MSG( "OPL: Snapshot was taken with a different oplmode" );
+		return false;
+	}
+	Bit32u size;
+	if ( !apply ) {
+		return in.Skip( sizeof( reg ) + sizeof( ctrl.active ) + sizeof( ctrl.index ) +
+			sizeof( ctrl.lvol ) + sizeof( ctrl.rvol ) + sizeof( lastUsed ) + sizeof( cache ) ) &&
+			in.Read( size ) && size == sizeof( chip ) && in.Skip( size + sizeof( bool ) );
+	}
+	bool enabled;
+	in.Read( reg );
+	in.Read( ctrl.active );
+	in.Read( ctrl.index );
+	in.Read( ctrl.lvol );
+	in.Read( ctrl.rvol );
+	in.Read( lastUsed );
+	in.Read( cache );
+	in.Read( size );
+	in.Read( chip );
+	in.Read( enabled );
+
+	//Opl3 mode and the 4 operator connections first, the keys last
+	const Bit32u regs = ( mode == MODE_OPL2 ) ? 0x100 : 0x200;
+	if ( regs == 0x200 ) {
+		handler->WriteReg( 0x105, cache[ 0x105 ] );
+		handler->WriteReg( 0x104, cache[ 0x104 ] );
+	}
+	for ( Bit32u i = 0; i < regs; i++ ) {
+		const Bit32u low = i & 0xff;
+		//The timer registers are in the chips, not in the cache
+		if ( ( low >= 0x02 && low <= 0x04 ) || i == 0x105 || IsKeyReg( i ) ) 
+			continue;
+		handler->WriteReg( i, cache[ i ] );
+	}
+	for ( Bit32u i = 0; i < regs; i++ ) {
+		if ( IsKeyReg( i ) ) 
+			handler->WriteReg( i, cache[ i ] );
+	}
+	if ( ctrl.mixer ) {
+		mixerChan->SetVolume( (float)(ctrl.lvol&0x1f)/31.0f, (float)(ctrl.rvol&0x1f)/31.0f );
+	}
+	mixerChan->Enable( enabled );
+	return true;
+}
+
 } // namespace Adlib
 
 static Adlib::Module* module = 0;
 
+static void OPL_SaveState(SnapshotWriter &out) {
+	module->SaveState( out );
+}
+
+static bool OPL_LoadState(SnapshotReader &in, bool apply) {
+	return module->LoadState( in, apply );
+}
+
 static void OPL_CallBack(Bitu len) {
 	module->handler->Generate( module->mixerChan, len );
 	//Disable the sound generation after 30 seconds of silence
@@ -903,9 +981,11 @@ OPL_Mode Module::oplmode=OPL_none;
 void OPL_Init(Section* sec,OPL_Mode oplmode) {
 	Adlib::Module::oplmode = oplmode;
 	module = new Adlib::Module( sec );
+	SNAPSHOT_Register( "opl", 1, OPL_SaveState, OPL_LoadState );
 }
 
 void OPL_ShutDown(Section* sec){
+	SNAPSHOT_Unregister( "opl" );
 	delete module;
 	module = 0;
 
@@ -29,6 +29,9 @@
 
 #include <cmath>
 
+class SnapshotReader;
+class SnapshotWriter;
+
 namespace Adlib {
 
 struct Timer {
@@ -149,6 +152,9 @@ public:
 	void PortWrite( Bitu port, Bitu val, Bitu iolen );
 	Bitu PortRead( Bitu port, Bitu iolen );
 	void Init( Mode m );
+	//Snapshot state, the chip is restored by writing the register cache again
+	void SaveState( SnapshotWriter &out ) const;
+	bool LoadState( SnapshotReader &in, bool apply );
 
 	Module(Section *configuration);
 	~Module() override;
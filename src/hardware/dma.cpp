@@ -25,6 +25,7 @@
 #include "pic.h"
 #include "paging.h"
 #include "setup.h"
+#include "snapshot.h"
 
 DmaController *DmaControllers[2];
 
@@ -79,6 +80,7 @@ static void DMA_BlockWrite(PhysPt spage,PhysPt offset,void * data,Bitu size,Bit8
 		if (page < EMM_PAGEFRAME4K) page = paging.firstmb[page];
 		else if (page < EMM_PAGEFRAME4K+0x10) page = ems_board_mapping[page];
 		else if (page < LINK_START) page = paging.firstmb[page];
+		MEM_MarkPageDirty(page);
 		phys_writeb(page*4096 + (offset & 4095), *read++);
 	}
 }
@@ -346,6 +348,77 @@ again:
 	return done;
 }
 
+void DmaController::SaveState(SnapshotWriter &out) const {
+	out.Write(flipflop);
+	for (const DmaChannel * chan : dma_channels) {
+		out.Write(chan->pagebase);
+		out.Write(chan->baseaddr);
+		out.Write(chan->curraddr);
+		out.Write(chan->basecnt);
+		out.Write(chan->currcnt);
+		out.Write(chan->pagenum);
+		out.Write(chan->increment);
+		out.Write(chan->autoinit);
+		out.Write(chan->masked);
+		out.Write(chan->tcount);
+		out.Write(chan->request);
+	}
+}
+
+bool DmaController::LoadState(SnapshotReader &in, bool apply) {
+	bool saved_flipflop;
+	if (!in.Read(saved_flipflop)) return false;
+	if (apply) flipflop=saved_flipflop;
+	for (DmaChannel * chan : dma_channels) {
+		DmaChannel saved(chan->channum,chan->DMA16!=0);
+		if (!in.Read(saved.pagebase) || !in.Read(saved.baseaddr) ||
+			!in.Read(saved.curraddr) || !in.Read(saved.basecnt) ||
+			!in.Read(saved.currcnt) || !in.Read(saved.pagenum) ||
+			!in.Read(saved.increment) || !in.Read(saved.autoinit) ||
+			!in.Read(saved.masked) || !in.Read(saved.tcount) ||
+			!in.Read(saved.request)) return false;
+		if (!apply) continue;
+		chan->pagebase=saved.pagebase;
+		chan->baseaddr=saved.baseaddr;
+		chan->curraddr=saved.curraddr;
+		chan->basecnt=saved.basecnt;
+		chan->currcnt=saved.currcnt;
+		chan->pagenum=saved.pagenum;
+		chan->increment=saved.increment;
+		chan->autoinit=saved.autoinit;
+		chan->masked=saved.masked;
+		chan->tcount=saved.tcount;
+		chan->request=saved.request;
+	}
+	return true;
+}
+
+static void DMA_SaveState(SnapshotWriter &out) {
+	out.Write(static_cast<Bit8u>(DmaControllers[1] ? 2 : 1));
+	for (const DmaController * controller : DmaControllers) {
+		if (controller) controller->SaveState(out);
+	}
+	out.Write(dma_wrapping);
+	out.Write(&ems_board_mapping[EMM_PAGEFRAME4K],0x10*sizeof(Bit32u));
+}
+
+static bool DMA_LoadState(SnapshotReader &in,bool apply) {
+	Bit8u controllers;
+	if (!in.Read(controllers) || controllers!=(DmaControllers[1] ? 2 : 1)) {
+		LOG_MSG("DMA: Snapshot has a different number of DMA controllers");
+		return false;
+	}
+	for (DmaController * controller : DmaControllers) {
+		if (controller && !controller->LoadState(in,apply)) return false;
+	}
+	Bit32u wrapping,mapping[0x10];
+	if (!in.Read(wrapping) || !in.Read(mapping)) return false;
+	if (!apply) return true;
+	dma_wrapping=wrapping;
+	memcpy(&ems_board_mapping[EMM_PAGEFRAME4K],mapping,sizeof(mapping));
+	return true;
+}
+
 class DMA : public Module_base {
 public:
 	DMA(Section *configuration) : Module_base(configuration)
@@ -379,6 +452,7 @@ public:
 			DmaControllers[1]->DMA_WriteHandler[0x10].Install(0x89,DMA_Write_Port,IO_MB,3);
 			DmaControllers[1]->DMA_ReadHandler[0x10].Install(0x89,DMA_Read_Port,IO_MB,3);
 		}
+		SNAPSHOT_Register("dma",1,DMA_SaveState,DMA_LoadState);
 	}
 	~DMA(){
 		if (DmaControllers[0]) {
@@ -34,6 +34,7 @@
 #include "pic.h"
 #include "setup.h"
 #include "shell.h"
+#include "snapshot.h"
 
 #define LOG_GUS 0 // set to 1 for detailed logging
 
@@ -154,6 +155,8 @@ public:
 	void WriteWaveRate(uint16_t rate) noexcept;
 	bool UpdateVolState(uint8_t state) noexcept;
 	bool UpdateWaveState(uint8_t state) noexcept;
+	void SaveState(SnapshotWriter &out) const;
+	bool LoadState(SnapshotReader &in, bool apply);
 
 	VoiceCtrl vol_ctrl;
 	VoiceCtrl wave_ctrl;
@@ -228,6 +231,8 @@ public:
 	Timer timer_one = {TIMER_1_DEFAULT_DELAY};
 	Timer timer_two = {TIMER_2_DEFAULT_DELAY};
 	bool PerformDmaTransfer();
+	void SaveState(SnapshotWriter &out) const;
+	bool LoadState(SnapshotReader &in, bool apply);
 
 private:
 	Gus() = delete;
@@ -585,6 +590,52 @@ void Voice::WriteWaveRate(uint16_t val) noexcept
 	wave_ctrl.inc = ceil_udivide(val, 2u);
 }
 
+static void save_voice_ctrl(SnapshotWriter &out, const VoiceCtrl &ctrl)
+{
+	out.Write(ctrl.start);
+	out.Write(ctrl.end);
+	out.Write(ctrl.pos);
+	out.Write(ctrl.inc);
+	out.Write(ctrl.rate);
+	out.Write(ctrl.state);
+}
+
+static bool load_voice_ctrl(SnapshotReader &in, VoiceCtrl &ctrl, bool apply)
+{
+	VoiceCtrl saved = {ctrl.irq_state};
+	if (!in.Read(saved.start) || !in.Read(saved.end) || !in.Read(saved.pos) ||
+	    !in.Read(saved.inc) || !in.Read(saved.rate) || !in.Read(saved.state))
+		return false;
+	if (apply) {
+		ctrl.start = saved.start;
+		ctrl.end = saved.end;
+		ctrl.pos = saved.pos;
+		ctrl.inc = saved.inc;
+		ctrl.rate = saved.rate;
+		ctrl.state = saved.state;
+	}
+	return true;
+}
+
+void Voice::SaveState(SnapshotWriter &out) const
+{
+	save_voice_ctrl(out, vol_ctrl);
+	save_voice_ctrl(out, wave_ctrl);
+	out.Write(pan_position);
+}
+
+bool Voice::LoadState(SnapshotReader &in, bool apply)
+{
+	uint8_t pos = 0u;
+	if (!load_voice_ctrl(in, vol_ctrl, apply) ||
+	    !load_voice_ctrl(in, wave_ctrl, apply) || !in.Read(pos) ||
+	    pos >= PAN_POSITIONS)
+		return false;
+	if (apply)
+		pan_position = pos;
+	return true;
+}
+
 Gus::Gus(uint16_t port, uint8_t dma, uint8_t irq, const std::string &ultradir)
         : port_base(port - 0x200u),
           dma2(dma),
@@ -1454,9 +1505,145 @@ void Gus::WriteToRegister()
 	return;
 }
 
+// The sample memory, the voices and the registers are saved. The samples
+// already handed to the mixer are not, playback continues with the next ones.
+void Gus::SaveState(SnapshotWriter &out) const
+{
+	SNAPSHOT_WriteBlock(out, ram.data(), ram.size());
+	for (const auto &v : voices)
+		v->SaveState(out);
+	out.Write(static_cast<uint32_t>(sizeof(Timer)));
+	out.Write(timer_one);
+	out.Write(timer_two);
+	out.Write(voice_irq);
+	out.Write(peak);
+	out.Write(voice != nullptr);
+	out.Write(voice_index);
+	out.Write(active_voice_mask);
+	out.Write(active_voices);
+	out.Write(dram_addr);
+	out.Write(playback_rate);
+	out.Write(register_data);
+	out.Write(selected_register);
+	out.Write(mix_ctrl);
+	out.Write(sample_ctrl);
+	out.Write(timer_ctrl);
+	out.Write(dma_addr);
+	out.Write(dma_ctrl);
+	out.Write(dma1);
+	out.Write(dma2);
+	out.Write(irq1);
+	out.Write(irq2);
+	out.Write(irq_status);
+	out.Write(irq_enabled);
+	out.Write(should_change_irq_dma);
+	out.Write(adlib_command_reg);
+	out.Write(audio_channel->is_enabled);
+}
+
+bool Gus::LoadState(SnapshotReader &in, bool apply)
+{
+	if (!SNAPSHOT_ReadBlock(in, apply ? ram.data() : nullptr, ram.size()))
+		return false;
+	for (auto &v : voices)
+		if (!v->LoadState(in, apply))
+			return false;
+
+	uint32_t timer_size = 0u;
+	if (!in.Read(timer_size) || timer_size != sizeof(Timer))
+		return false;
+	Timer saved_timers[2];
+	VoiceIrq saved_voice_irq = {};
+	AudioFrame saved_peak = {};
+	bool voice_selected = false;
+	uint16_t saved_voice_index = 0u;
+	uint32_t saved_voice_mask = 0u;
+	uint8_t saved_voices = 0u;
+	uint32_t saved_dram_addr = 0u;
+	uint32_t saved_playback_rate = 0u;
+	uint16_t saved_register_data = 0u;
+	uint8_t saved_register = 0u;
+	uint8_t ctrls[3] = {}; // mix, sample, and timer
+	uint16_t saved_dma_addr = 0u;
+	uint8_t saved_dma_ctrl = 0u;
+	uint8_t saved_dma[2] = {};
+	uint8_t saved_irq[2] = {};
+	uint8_t saved_irq_status = 0u;
+	bool saved_irq_enabled = false;
+	bool saved_change_irq_dma = false;
+	uint8_t saved_adlib_command_reg = 0u;
+	bool enabled = false;
+	if (!in.Read(saved_timers) || !in.Read(saved_voice_irq) ||
+	    !in.Read(saved_peak) || !in.Read(voice_selected) ||
+	    !in.Read(saved_voice_index) || !in.Read(saved_voice_mask) ||
+	    !in.Read(saved_voices) || !in.Read(saved_dram_addr) ||
+	    !in.Read(saved_playback_rate) || !in.Read(saved_register_data) ||
+	    !in.Read(saved_register) || !in.Read(ctrls) ||
+	    !in.Read(saved_dma_addr) || !in.Read(saved_dma_ctrl) ||
+	    !in.Read(saved_dma) || !in.Read(saved_irq) ||
+	    !in.Read(saved_irq_status) || !in.Read(saved_irq_enabled) ||
+	    !in.Read(saved_change_irq_dma) ||
+	    !in.Read(saved_adlib_command_reg) || !in.Read(enabled))
+		return false;
+	if (saved_voice_index >= voices.size() || saved_voices > MAX_VOICES ||
+	    !GetDMAChannel(saved_dma[0]))
+		return false;
+	if (!apply)
+		return true;
+
+	timer_one = saved_timers[0];
+	timer_two = saved_timers[1];
+	voice_irq = saved_voice_irq;
+	peak = saved_peak;
+	voice_index = saved_voice_index;
+	voice = voice_selected ? voices.at(voice_index).get() : nullptr;
+	active_voice_mask = saved_voice_mask;
+	active_voices = saved_voices;
+	dram_addr = saved_dram_addr;
+	playback_rate = saved_playback_rate;
+	register_data = saved_register_data;
+	selected_register = saved_register;
+	mix_ctrl = ctrls[0];
+	sample_ctrl = ctrls[1];
+	timer_ctrl = ctrls[2];
+	dma_addr = saved_dma_addr;
+	dma_ctrl = saved_dma_ctrl;
+	dma2 = saved_dma[1];
+	irq1 = saved_irq[0];
+	irq2 = saved_irq[1];
+	irq_status = saved_irq_status;
+	irq_enabled = saved_irq_enabled;
+	should_change_irq_dma = saved_change_irq_dma;
+	adlib_command_reg = saved_adlib_command_reg;
+
+	// Move the DMA callback without the mask event, the DMA state and the
+	// pending transfer event are restored already
+	if (saved_dma[0] != dma1) {
+		dma_channel->callback = nullptr;
+		dma1 = saved_dma[0];
+		dma_channel = GetDMAChannel(dma1);
+		dma_channel->callback = std::bind(&Gus::DmaCallback, this, _1, _2);
+	}
+	if (playback_rate)
+		audio_channel->SetFreq(playback_rate);
+	audio_channel->Enable(enabled);
+	return true;
+}
+
+static void gus_save_state(SnapshotWriter &out)
+{
+	gus->SaveState(out);
+}
+
+static bool gus_load_state(SnapshotReader &in, bool apply)
+{
+	return gus->LoadState(in, apply);
+}
+
 static void gus_destroy(MAYBE_UNUSED Section *sec)
 {
 	if (gus) {
+		SNAPSHOT_Unregister("gus");
 		gus->PrintStats();
 		gus.reset(nullptr);
 	}
@@ -1477,6 +1664,9 @@ static void gus_init(Section *sec)
 
 	// Instantiate the GUS with the settings
 	gus = std::make_unique<Gus>(port, dma, irq, ultradir);
+	PIC_RegisterSnapshotEvent("gus_timer", GUS_TimerEvent);
+	PIC_RegisterSnapshotEvent("gus_dma", GUS_DMA_Event);
+	SNAPSHOT_Register("gus", 1, gus_save_state, gus_load_state);
 	sec->AddDestroyFunction(&gus_destroy, true);
 }
 
@@ -30,6 +30,25 @@
 std::unordered_map<io_port_t, IO_WriteHandler> io_writehandlers[IO_SIZES] = {};
 std::unordered_map<io_port_t, IO_ReadHandler> io_readhandlers[IO_SIZES] = {};
 
+// Flat per-port dispatch tables in front of the handler maps, so a port
+// access is an index instead of a hash lookup. A slot holds either the
+// plain function or a pointer to the handler in the map (map elements
+// don't move when the map grows). Empty slots go to the default handlers.
+#define IO_PORTS 0x10000
+
+struct IO_ReadSlot {
+	IO_ReadFunction function;
+	const IO_ReadHandler *handler;
+};
+
+struct IO_WriteSlot {
+	IO_WriteFunction function;
+	const IO_WriteHandler *handler;
+};
+
+static IO_ReadSlot io_readslots[IO_SIZES][IO_PORTS];
+static IO_WriteSlot io_writeslots[IO_SIZES][IO_PORTS];
+
 void port_within_proposed(io_port_t port) {
 	assert(port < std::numeric_limits<io_port_t_proposed>::max());
 }
@@ -49,26 +68,64 @@ static void WriteBlocked(io_port_t /*port*/, io_val_t /*val*/, Bitu /*iolen*/)
 static io_val_t ReadDefault(io_port_t port, Bitu iolen);
 static void WriteDefault(io_port_t port, io_val_t val, Bitu iolen);
 
-// The ReadPort and WritePort functions lookup and call the handler
-// at the desired port. If the port hasn't been assigned (and the
-// lookup is empty), then the default handler is assigned and called.
+static void SetReadHandler(uint8_t idx, io_port_t port, const IO_ReadHandler &handler)
+{
+	const IO_ReadHandler &stored = io_readhandlers[idx][port] = handler;
+	const IO_ReadFunction *function = stored.target<IO_ReadFunction>();
+	IO_ReadSlot &slot = io_readslots[idx][port & (IO_PORTS - 1)];
+	slot.function = function ? *function : nullptr;
+	slot.handler = function ? nullptr : &stored;
+}
+
+static void SetWriteHandler(uint8_t idx, io_port_t port, const IO_WriteHandler &handler)
+{
+	const IO_WriteHandler &stored = io_writehandlers[idx][port] = handler;
+	const IO_WriteFunction *function = stored.target<IO_WriteFunction>();
+	IO_WriteSlot &slot = io_writeslots[idx][port & (IO_PORTS - 1)];
+	slot.function = function ? *function : nullptr;
+	slot.handler = function ? nullptr : &stored;
+}
+
+static void FreeReadHandler(uint8_t idx, io_port_t port)
+{
+	io_readslots[idx][port & (IO_PORTS - 1)] = {nullptr, nullptr};
+	io_readhandlers[idx].erase(port);
+}
+
+static void FreeWriteHandler(uint8_t idx, io_port_t port)
+{
+	io_writeslots[idx][port & (IO_PORTS - 1)] = {nullptr, nullptr};
+	io_writehandlers[idx].erase(port);
+}
+
+// The ReadPort and WritePort functions call the handler at the desired
+// port. If the port hasn't been assigned, the default handler is called.
 static io_val_t ReadPort(uint8_t req_bytes, io_port_t port)
 {
-	// Convert bytes to handler map index MB.0x1->0, MW.0x2->1, and MD.0x4->2
+	// Convert bytes to handler table index MB.0x1->0, MW.0x2->1, and MD.0x4->2
 	const uint8_t idx = req_bytes >> 1;
-	return io_readhandlers[idx].emplace(port, ReadDefault).first->second(port, req_bytes);
+	const IO_ReadSlot &slot = io_readslots[idx][port & (IO_PORTS - 1)];
+	if (GCC_LIKELY(slot.function))
+		return slot.function(port, req_bytes);
+	if (slot.handler)
+		return (*slot.handler)(port, req_bytes);
+	return ReadDefault(port, req_bytes);
 }
 
 static void WritePort(uint8_t put_bytes, io_port_t port, io_val_t val)
 {
-	// Convert bytes to handler map index MB.0x1->0, MW.0x2->1, and MD.0x4->2
+	// Convert bytes to handler table index MB.0x1->0, MW.0x2->1, and MD.0x4->2
 	const uint8_t idx = put_bytes >> 1;
 
 	 // Convert bytes into a cut-off mask: 1->0xff, 2->0xffff, 4->0xffffff
 	const auto mask = (1ul << (put_bytes * 8)) - 1;
-	io_writehandlers[idx]
-	        .emplace(port, WriteDefault)
-	        .first->second(port, val & mask, put_bytes);
+	const IO_WriteSlot &slot = io_writeslots[idx][port & (IO_PORTS - 1)];
+	if (GCC_LIKELY(slot.function))
+		slot.function(port, val & mask, put_bytes);
+	else if (slot.handler)
+		(*slot.handler)(port, val & mask, put_bytes);
+	else
+		WriteDefault(port, val & mask, put_bytes);
 }
 
 static io_val_t ReadDefault(io_port_t port, Bitu iolen)
@@ -79,7 +136,7 @@ static io_val_t ReadDefault(io_port_t port, Bitu iolen)
 	case 1:
 		LOG(LOG_IO, LOG_WARN)("IOBUS: Unexpected read from %04xh; blocking",
 		                      static_cast<uint32_t>(port));
-		io_readhandlers[0][port] = ReadBlocked;
+		SetReadHandler(0, port, ReadBlocked);
 		return 0xff;
 	case 2: return ReadPort(IO_MB, port) | (ReadPort(IO_MB, port + 1) << 8);
 	case 4: return ReadPort(IO_MW, port) | (ReadPort(IO_MW, port + 2) << 16);
@@ -97,7 +154,7 @@ static void WriteDefault(io_port_t port, io_val_t val, Bitu iolen)
 		LOG(LOG_IO, LOG_WARN)("IOBUS: Unexpected write of %u to %04xh; blocking",
 		                      static_cast<uint32_t>(val),
 		                      static_cast<uint32_t>(port));
-		io_writehandlers[0][port] = WriteBlocked;
+		SetWriteHandler(0, port, WriteBlocked);
 		break;
 	case 2:
 		WritePort(IO_MB, port, val);
@@ -115,9 +172,9 @@ void IO_RegisterReadHandler(io_port_t port, IO_ReadHandler handler, Bitu mask, B
 	port_within_proposed(port);
 
 	while (range--) {
-		if (mask&IO_MB) io_readhandlers[0][port]=handler;
-		if (mask&IO_MW) io_readhandlers[1][port]=handler;
-		if (mask&IO_MD) io_readhandlers[2][port]=handler;
+		if (mask&IO_MB) SetReadHandler(0, port, handler);
+		if (mask&IO_MW) SetReadHandler(1, port, handler);
+		if (mask&IO_MD) SetReadHandler(2, port, handler);
 		port++;
 	}
 }
@@ -127,9 +184,9 @@ void IO_RegisterWriteHandler(io_port_t port, IO_WriteHandler handler, Bitu mask,
 	port_within_proposed(port);
 
 	while (range--) {
-		if (mask&IO_MB) io_writehandlers[0][port]=handler;
-		if (mask&IO_MW) io_writehandlers[1][port]=handler;
-		if (mask&IO_MD) io_writehandlers[2][port]=handler;
+		if (mask&IO_MB) SetWriteHandler(0, port, handler);
+		if (mask&IO_MW) SetWriteHandler(1, port, handler);
+		if (mask&IO_MD) SetWriteHandler(2, port, handler);
 		port++;
 	}
 }
@@ -140,11 +197,11 @@ void IO_FreeReadHandler(io_port_t port, Bitu mask, Bitu range)
 
 	while (range--) {
 		if (mask & IO_MB)
-			io_readhandlers[0].erase(port);
+			FreeReadHandler(0, port);
 		if (mask & IO_MW)
-			io_readhandlers[1].erase(port);
+			FreeReadHandler(1, port);
 		if (mask & IO_MD)
-			io_readhandlers[2].erase(port);
+			FreeReadHandler(2, port);
 		port++;
 	}
 }
@@ -155,11 +212,11 @@ void IO_FreeWriteHandler(io_port_t port, Bitu mask, Bitu range)
 
 	while (range--) {
 		if (mask & IO_MB)
-			io_writehandlers[0].erase(port);
+			FreeWriteHandler(0, port);
 		if (mask & IO_MW)
-			io_writehandlers[1].erase(port);
+			FreeWriteHandler(1, port);
 		if (mask & IO_MD)
-			io_writehandlers[2].erase(port);
+			FreeWriteHandler(2, port);
 		port++;
 	}
 }
@@ -598,6 +655,10 @@ public:
 			               sizeof(io_readhandlers[i]);
 			io_readhandlers[i].clear();
 			io_writehandlers[i].clear();
+			for (auto &slot : io_readslots[i])
+				slot = {nullptr, nullptr};
+			for (auto &slot : io_writeslots[i])
+				slot = {nullptr, nullptr};
 		}
 		DEBUG_LOG_MSG("IOBUS: Handlers consumed %lu total bytes", total_bytes);
 	}
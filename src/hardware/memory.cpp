@@ -23,9 +23,21 @@
 #include "setup.h"
 #include "paging.h"
 #include "regs.h"
+#include "snapshot.h"
 
 #include <string.h>
 
+#if C_SSHOT
+#include <zlib.h>
+#endif
+
+#if (C_HAVE_MPROTECT)
+#include <sys/mman.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
 #define PAGES_IN_BLOCK	((1024*1024)/MEM_PAGE_SIZE)
 #define SAFE_MEMORY	32
 #define MAX_MEMORY	64
@@ -54,9 +66,13 @@ static struct MemoryBlock {
 		bool enabled;
 		Bit8u controlport;
 	} a20;
+	struct {
+		Bit32u * bits;
+	} dirty;
 } memory;
 
 HostPt MemBase;
+bool MemDirtyTracking = false;
 
 class IllegalPageHandler : public PageHandler {
 public:
@@ -88,6 +104,14 @@ public:
 	}
 };
 
+/* First write to a clean page while dirty tracking is on */
+static HostPt MEM_DirtyWritePt(PhysPt addr) {
+	Bitu phys_page=PAGING_GetPhysicalPage(addr)>>12;
+	MEM_MarkPageDirty(phys_page);
+	PAGING_LinkPage(addr>>12,phys_page);
+	return MemBase+phys_page*MEM_PAGESIZE+(addr&(MEM_PAGESIZE-1));
+}
+
 class RAMPageHandler : public PageHandler {
 public:
 	RAMPageHandler() {
@@ -99,6 +123,16 @@ public:
 	HostPt GetHostWritePt(Bitu phys_page) {
 		return MemBase+phys_page*MEM_PAGESIZE;
 	}
+	/* Writes only end up here for write trapped pages */
+	void writeb(PhysPt addr,Bitu val) {
+		host_writeb(MEM_DirtyWritePt(addr),(Bit8u)val);
+	}
+	void writew(PhysPt addr,Bitu val) {
+		host_writew(MEM_DirtyWritePt(addr),(Bit16u)val);
+	}
+	void writed(PhysPt addr,Bitu val) {
+		host_writed(MEM_DirtyWritePt(addr),(Bit32u)val);
+	}
 };
 
 class ROMPageHandler : public RAMPageHandler {
@@ -146,6 +180,8 @@ PageHandler * MEM_GetPageHandler(Bitu phys_page) {
 
 void MEM_SetPageHandler(Bitu phys_page,Bitu pages,PageHandler * handler) {
 	for (;pages>0;pages--) {
+		/* Writes through other handlers (translated code) aren't seen */
+		MEM_MarkPageDirty(phys_page);
 		memory.phandlers[phys_page]=handler;
 		phys_page++;
 	}
@@ -153,11 +189,55 @@ void MEM_SetPageHandler(Bitu phys_page,Bitu pages,PageHandler * handler) {
 
 void MEM_ResetPageHandler(Bitu phys_page, Bitu pages) {
 	for (;pages>0;pages--) {
+		MEM_MarkPageDirty(phys_page);
 		memory.phandlers[phys_page]=&ram_page_handler;
 		phys_page++;
 	}
 }
 
+void MEM_SetDirtyTracking(bool enable) {
+	if (MemDirtyTracking==enable) return;
+	if (enable && !memory.dirty.bits) {
+		memory.dirty.bits=new Bit32u[(memory.pages+31)/32];
+	}
+	MemDirtyTracking=enable;
+	MEM_ClearDirtyPages();
+}
+
+bool MEM_DirtyTrackingEnabled(void) {
+	return MemDirtyTracking;
+}
+
+bool MEM_PageDirty(Bitu phys_page) {
+	if (!MemDirtyTracking || phys_page>=memory.pages) return true;
+	if (memory.phandlers[phys_page]->flags & (PFLAG_HASCODE|PFLAG_PREDECODED)) return true;
+	/* The Tandy and PCjr video window writes its banks of RAM through host
+	 * pointers of its own, the first 128kb on the PCjr and the last 128kb
+	 * below 640kb on the Tandy */
+	if (IS_TANDY_ARCH) {
+		const Bitu video_page=(machine==MCH_PCJR) ? 0x00 : 0x80;
+		if (phys_page>=video_page && phys_page<video_page+0x20) return true;
+	}
+	return (memory.dirty.bits[phys_page>>5] & (1u << (phys_page & 31)))!=0;
+}
+
+void MEM_MarkPageDirty(Bitu phys_page) {
+	if (!MemDirtyTracking || phys_page>=memory.pages) return;
+	memory.dirty.bits[phys_page>>5]|=1u << (phys_page & 31);
+}
+
+void MEM_ClearDirtyPages(void) {
+	if (memory.dirty.bits) memset(memory.dirty.bits,0,sizeof(Bit32u)*((memory.pages+31)/32));
+	/* Drop the write pointers of the pages linked so far */
+	PAGING_ClearTLB();
+}
+
+bool MEM_PageWriteTrapped(Bitu phys_page) {
+	if (!MemDirtyTracking || phys_page>=memory.pages) return false;
+	if (memory.phandlers[phys_page]!=&ram_page_handler) return false;
+	return (memory.dirty.bits[phys_page>>5] & (1u << (phys_page & 31)))==0;
+}
+
 Bitu mem_strlen(PhysPt pt) {
 	Bitu x=0;
 	while (x<1024) {
@@ -173,21 +253,60 @@ void mem_strcpy(PhysPt dest,PhysPt src) {
 	mem_writeb_inline(dest,0);
 }
 
+/* The block functions below work on runs that stay within one page. Runs
+   on pages with a direct host pointer in the TLB are copied in one go,
+   everything else goes through the page handler a byte at a time. Such
+   a byte access also initializes the TLB entry of a page that was not
+   used yet, so the rest of it is copied directly again. */
+static INLINE Bitu PageRun(PhysPt pt,Bitu size) {
+	Bitu left=MEM_PAGE_SIZE-(pt & (MEM_PAGE_SIZE-1));
+	return (size<left) ? size : left;
+}
+
 void mem_memcpy(PhysPt dest,PhysPt src,Bitu size) {
-	while (size--) mem_writeb_inline(dest++,mem_readb_inline(src++));
+	while (size) {
+		Bitu run=PageRun(dest,PageRun(src,size));
+		HostPt tlb_read=get_tlb_read(src);
+		HostPt tlb_write=get_tlb_write(dest);
+		/* Forward overlapping copies repeat the source pattern like the
+		   byte loop always did, those stay bytewise */
+		if (tlb_read && tlb_write && (dest<=src || dest-src>=run)) {
+			memmove(tlb_write+dest,tlb_read+src,run);
+		} else {
+			run=1;
+			mem_writeb_inline(dest,mem_readb_inline(src));
+		}
+		dest+=run;src+=run;size-=run;
+	}
 }
 
 void MEM_BlockRead(PhysPt pt,void * data,Bitu size) {
 	Bit8u * write=reinterpret_cast<Bit8u *>(data);
-	while (size--) {
-		*write++=mem_readb_inline(pt++);
+	while (size) {
+		Bitu run=PageRun(pt,size);
+		HostPt tlb_addr=get_tlb_read(pt);
+		if (tlb_addr) {
+			memcpy(write,tlb_addr+pt,run);
+		} else {
+			run=1;
+			*write=mem_readb_inline(pt);
+		}
+		pt+=run;write+=run;size-=run;
 	}
 }
 
 void MEM_BlockWrite(PhysPt pt,void const * const data,Bitu size) {
 	Bit8u const * read = reinterpret_cast<Bit8u const * const>(data);
-	while (size--) {
-		mem_writeb_inline(pt++,*read++);
+	while (size) {
+		Bitu run=PageRun(pt,size);
+		HostPt tlb_addr=get_tlb_write(pt);
+		if (tlb_addr) {
+			memcpy(tlb_addr+pt,read,run);
+		} else {
+			run=1;
+			mem_writeb_inline(pt,*read);
+		}
+		pt+=run;read+=run;size-=run;
 	}
 }
 
@@ -426,13 +545,43 @@ void MEM_A20_Enable(bool enabled) {
 
 
 /* Memory access functions */
+
+/* Accesses that cross into the next page. When both pages are linked in
+   the TLB the bytes are copied from the two host pages at once, otherwise
+   they go through the handlers one byte at a time. */
+static INLINE bool SplitRead(PhysPt address,Bit8u * data,Bitu size) {
+	Bitu first=MEM_PAGE_SIZE-(address & (MEM_PAGE_SIZE-1));
+	if (first>size) first=size;
+	HostPt lo=get_tlb_read(address);
+	HostPt hi=get_tlb_read(address+first);
+	if (!lo || !hi) return false;
+	memcpy(data,lo+address,first);
+	memcpy(data+first,hi+address+first,size-first);
+	return true;
+}
+
+static INLINE bool SplitWrite(PhysPt address,const Bit8u * data,Bitu size) {
+	Bitu first=MEM_PAGE_SIZE-(address & (MEM_PAGE_SIZE-1));
+	if (first>size) first=size;
+	HostPt lo=get_tlb_write(address);
+	HostPt hi=get_tlb_write(address+first);
+	if (!lo || !hi) return false;
+	memcpy(lo+address,data,first);
+	memcpy(hi+address+first,data+first,size-first);
+	return true;
+}
+
 Bit16u mem_unalignedreadw(PhysPt address) {
+	Bit8u data[2];
+	if (SplitRead(address,data,2)) return host_readw(data);
 	Bit16u ret = mem_readb_inline(address);
 	ret       |= mem_readb_inline(address+1) << 8;
 	return ret;
 }
 
 Bit32u mem_unalignedreadd(PhysPt address) {
+	Bit8u data[4];
+	if (SplitRead(address,data,4)) return host_readd(data);
 	Bit32u ret = mem_readb_inline(address);
 	ret       |= mem_readb_inline(address+1) << 8;
 	ret       |= mem_readb_inline(address+2) << 16;
@@ -442,11 +591,17 @@ Bit32u mem_unalignedreadd(PhysPt address) {
 
 
 void mem_unalignedwritew(PhysPt address,Bit16u val) {
+	Bit8u data[2];
+	host_writew(data,val);
+	if (SplitWrite(address,data,2)) return;
 	mem_writeb_inline(address,(Bit8u)val);val>>=8;
 	mem_writeb_inline(address+1,(Bit8u)val);
 }
 
 void mem_unalignedwrited(PhysPt address,Bit32u val) {
+	Bit8u data[4];
+	host_writed(data,val);
+	if (SplitWrite(address,data,4)) return;
 	mem_writeb_inline(address,(Bit8u)val);val>>=8;
 	mem_writeb_inline(address+1,(Bit8u)val);val>>=8;
 	mem_writeb_inline(address+2,(Bit8u)val);val>>=8;
@@ -455,6 +610,11 @@ void mem_unalignedwrited(PhysPt address,Bit32u val) {
 
 
 bool mem_unalignedreadw_checked(PhysPt address, Bit16u * val) {
+	Bit8u data[2];
+	if (SplitRead(address,data,2)) {
+		*val=host_readw(data);
+		return false;
+	}
 	Bit8u rval1,rval2;
 	if (mem_readb_checked(address+0, &rval1)) return true;
 	if (mem_readb_checked(address+1, &rval2)) return true;
@@ -463,6 +623,11 @@ bool mem_unalignedreadw_checked(PhysPt address, Bit16u * val) {
 }
 
 bool mem_unalignedreadd_checked(PhysPt address, Bit32u * val) {
+	Bit8u data[4];
+	if (SplitRead(address,data,4)) {
+		*val=host_readd(data);
+		return false;
+	}
 	Bit8u rval1,rval2,rval3,rval4;
 	if (mem_readb_checked(address+0, &rval1)) return true;
 	if (mem_readb_checked(address+1, &rval2)) return true;
@@ -473,6 +638,9 @@ bool mem_unalignedreadd_checked(PhysPt address, Bit32u * val) {
 }
 
 bool mem_unalignedwritew_checked(PhysPt address, Bit16u val) {
+	Bit8u data[2];
+	host_writew(data,val);
+	if (SplitWrite(address,data,2)) return false;
 	if (mem_writeb_checked(address+0, (Bit8u)(val & 0xff))) return true;
 	val >>= 8;
 	if (mem_writeb_checked(address+1, (Bit8u)(val & 0xff))) return true;
@@ -480,6 +648,9 @@ bool mem_unalignedwritew_checked(PhysPt address, Bit16u val) {
 }
 
 bool mem_unalignedwrited_checked(PhysPt address, Bit32u val) {
+	Bit8u data[4];
+	host_writed(data,val);
+	if (SplitWrite(address,data,4)) return false;
 	if (mem_writeb_checked(address+0, (Bit8u)(val & 0xff))) return true;
 	val >>= 8;
 	if (mem_writeb_checked(address+1, (Bit8u)(val & 0xff))) return true;
@@ -541,10 +712,235 @@ void PreparePCJRCartRom(void) {
 
 HostPt GetMemBase(void) { return MemBase; }
 
+/* Guest RAM is stored in chunks of MEM_SNAPSHOT_CHUNK pages. A chunk is
+ * the mask of its pages that aren't all zeroes and those pages, zlib
+ * compressed in builds that link zlib. Encoded chunks are kept between
+ * saves and dirty page tracking runs from the first save on, so a save
+ * only encodes the chunks written to since the previous one. */
+#define MEM_SNAPSHOT_CHUNK 16
+#define MEM_SNAPSHOT_CHUNK_BYTES (MEM_SNAPSHOT_CHUNK * MEM_PAGESIZE)
+// Well above what zlib makes of incompressible data
+#define MEM_SNAPSHOT_CHUNK_MAX (3 + 2 * MEM_SNAPSHOT_CHUNK_BYTES)
+
+static std::vector<std::vector<Bit8u>> snapshot_chunks;
+
+static Bitu MEM_SnapshotChunks()
+{
+	return (memory.pages + MEM_SNAPSHOT_CHUNK - 1) / MEM_SNAPSHOT_CHUNK;
+}
+
+static Bitu MEM_ChunkEnd(Bitu first)
+{
+	const Bitu end = first + MEM_SNAPSHOT_CHUNK;
+	return (end < memory.pages) ? end : memory.pages;
+}
+
+static bool MEM_ChunkDirty(Bitu chunk)
+{
+	const Bitu first = chunk * MEM_SNAPSHOT_CHUNK;
+	for (Bitu page = first; page < MEM_ChunkEnd(first); page++)
+		if (MEM_PageDirty(page))
+			return true;
+	return false;
+}
+
+/* Layout: Bit16u page mask, Bit8u compressed, page data */
+static void MEM_EncodeChunk(Bitu chunk, std::vector<Bit8u> &out)
+{
+	static const Bit8u zero_page[MEM_PAGESIZE] = {};
+	static Bit8u raw[MEM_SNAPSHOT_CHUNK_BYTES];
+	const Bitu first = chunk * MEM_SNAPSHOT_CHUNK;
+	Bit16u mask = 0;
+	Bitu used = 0;
+	for (Bitu page = first; page < MEM_ChunkEnd(first); page++) {
+		const HostPt data = MemBase + page * MEM_PAGESIZE;
+		if (memcmp(data, zero_page, MEM_PAGESIZE) == 0)
+			continue;
+		mask |= 1 << (page - first);
+		memcpy(raw + used, data, MEM_PAGESIZE);
+		used += MEM_PAGESIZE;
+	}
+	out.resize(3);
+	memcpy(out.data(), &mask, sizeof(mask));
+	out[2] = 0;
+	if (!used)
+		return;
+#if C_SSHOT
+	uLongf packed_size = compressBound(used);
+	out.resize(3 + packed_size);
+	if (compress2(out.data() + 3, &packed_size, raw, used, Z_BEST_SPEED) == Z_OK) {
+		out.resize(3 + packed_size);
+		out[2] = 1;
+		return;
+	}
+	out.resize(3);
+#endif
+	out.insert(out.end(), raw, raw + used);
+}
+
+/* Unpacks a chunk into raw, false when it doesn't fit the memory layout */
+static bool MEM_DecodeChunk(Bitu chunk, const std::vector<Bit8u> &in,
+                            Bit16u &mask, Bit8u *raw)
+{
+	if (in.size() < 3)
+		return false;
+	memcpy(&mask, in.data(), sizeof(mask));
+	const Bitu first = chunk * MEM_SNAPSHOT_CHUNK;
+	const Bitu pages = MEM_ChunkEnd(first) - first;
+	if (pages < MEM_SNAPSHOT_CHUNK && (mask >> pages))
+		return false;
+	Bitu used = 0;
+	for (Bitu i = 0; i < pages; i++)
+		if (mask & (1 << i))
+			used += MEM_PAGESIZE;
+	if (!in[2]) {
+		if (in.size() - 3 != used)
+			return false;
+		memcpy(raw, in.data() + 3, used);
+		return true;
+	}
+#if C_SSHOT
+	uLongf raw_size = used;
+	return in[2] == 1 &&
+	       uncompress(raw, &raw_size, in.data() + 3, in.size() - 3) == Z_OK &&
+	       raw_size == used;
+#else
+	LOG_MSG("MEMORY: Snapshot is compressed, this build has no zlib");
+	return false;
+#endif
+}
+
+static void MEM_SaveState(SnapshotWriter &out)
+{
+	const Bitu chunks = MEM_SnapshotChunks();
+	const bool incremental = MEM_DirtyTrackingEnabled() &&
+	                         snapshot_chunks.size() == chunks;
+	if (!incremental)
+		snapshot_chunks.assign(chunks, {});
+	for (Bitu chunk = 0; chunk < chunks; chunk++)
+		if (!incremental || MEM_ChunkDirty(chunk))
+			MEM_EncodeChunk(chunk, snapshot_chunks[chunk]);
+	/* Write protects all pages again */
+	if (MEM_DirtyTrackingEnabled())
+		MEM_ClearDirtyPages();
+	else
+		MEM_SetDirtyTracking(true);
+
+	out.Write(static_cast<Bit32u>(memory.pages));
+	out.Write(memory.a20.enabled);
+	out.Write(memory.a20.controlport);
+	out.Write(memory.mhandles, sizeof(MemHandle) * memory.pages);
+	for (const auto &chunk : snapshot_chunks) {
+		out.Write(static_cast<Bit32u>(chunk.size()));
+		out.Write(chunk.data(), chunk.size());
+	}
+}
+
+static void MEM_RestorePage(Bitu page, const Bit8u *data)
+{
+	const HostPt host = MemBase + page * MEM_PAGESIZE;
+	MEM_MarkPageDirty(page);
+	const Bitu code_flags = PFLAG_HASCODE | PFLAG_PREDECODED;
+	if (!(MEM_GetPageHandler(page)->flags & code_flags)) {
+		memcpy(host, data, MEM_PAGESIZE);
+		return;
+	}
+	/* Pages with translated or predecoded code go through their handler
+	 * so the blocks get invalidated, the handler can release itself
+	 * halfway through */
+	for (Bitu i = 0; i < MEM_PAGESIZE; i++) {
+		PageHandler *handler = MEM_GetPageHandler(page);
+		if (handler->flags & code_flags)
+			handler->writeb(page * MEM_PAGESIZE + i, data[i]);
+		else
+			host[i] = data[i];
+	}
+}
+
+static bool MEM_LoadState(SnapshotReader &in, bool apply)
+{
+	static const Bit8u zero_page[MEM_PAGESIZE] = {};
+	static Bit8u raw[MEM_SNAPSHOT_CHUNK_BYTES];
+	Bit32u pages;
+	bool a20_enabled;
+	Bit8u a20_controlport;
+	if (!in.Read(pages) || pages != memory.pages) {
+		LOG_MSG("MEMORY: Snapshot has a different memory size");
+		return false;
+	}
+	std::vector<MemHandle> mhandles(memory.pages);
+	if (!in.Read(a20_enabled) || !in.Read(a20_controlport) ||
+	    !in.Read(mhandles.data(), sizeof(MemHandle) * memory.pages))
+		return false;
+	if (apply)
+		memcpy(memory.mhandles, mhandles.data(), sizeof(MemHandle) * memory.pages);
+
+	std::vector<Bit8u> encoded;
+	for (Bitu chunk = 0; chunk < MEM_SnapshotChunks(); chunk++) {
+		Bit32u size;
+		Bit16u mask;
+		if (!in.Read(size) || size > MEM_SNAPSHOT_CHUNK_MAX)
+			return false;
+		encoded.resize(size);
+		if (!in.Read(encoded.data(), size) ||
+		    !MEM_DecodeChunk(chunk, encoded, mask, raw))
+			return false;
+		if (!apply)
+			continue;
+		const Bitu first = chunk * MEM_SNAPSHOT_CHUNK;
+		const Bit8u *data = raw;
+		for (Bitu page = first; page < MEM_ChunkEnd(first); page++) {
+			if (mask & (1 << (page - first))) {
+				MEM_RestorePage(page, data);
+				data += MEM_PAGESIZE;
+			} else {
+				MEM_RestorePage(page, zero_page);
+			}
+		}
+	}
+	if (!apply)
+		return true;
+	/* The next save encodes everything again */
+	snapshot_chunks.clear();
+	memory.a20.controlport = a20_controlport;
+	MEM_A20_Enable(a20_enabled);
+	/* Page tables may have changed underneath the TLB */
+	PAGING_ClearTLB();
+	return true;
+}
+
 class MEMORY : public Module_base {
 private:
 	IO_ReadHandleObject ReadHandler{};
 	IO_WriteHandleObject WriteHandler{};
+	size_t mem_bytes = 0;
+	bool mem_mapped = false;
+
+	void AllocateBase(bool huge_pages)
+	{
+		MemBase = nullptr;
+#if (C_HAVE_MPROTECT) && defined(MAP_ANONYMOUS)
+		/* Anonymous mappings come zero filled and are only populated as
+		 * the guest touches them, forked processes share them copy-on-write
+		 */
+		void *base = mmap(nullptr, mem_bytes, PROT_READ | PROT_WRITE,
+		                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base != MAP_FAILED) {
+			MemBase = static_cast<HostPt>(base);
+			mem_mapped = true;
+#if defined(MADV_HUGEPAGE)
+			if (huge_pages && madvise(base, mem_bytes, MADV_HUGEPAGE) != 0)
+				LOG_MSG("MEMORY: Huge pages are not available");
+#endif
+			return;
+		}
+#endif
+		if (huge_pages)
+			LOG_MSG("MEMORY: Huge pages are not supported on this host");
+		MemBase = new (std::nothrow) Bit8u[mem_bytes];
+		if (MemBase)
+			memset((void*)MemBase, 0, mem_bytes);
+	}
 
 public:
 	MEMORY(Section *configuration) : Module_base(configuration)
@@ -565,11 +961,11 @@ public:
 			LOG_MSG("Memory sizes above %d MB are NOT recommended.",SAFE_MEMORY - 1);
 			LOG_MSG("Stick with the default values unless you are absolutely certain.");
 		}
-		MemBase = new (std::nothrow) Bit8u[memsize * 1024 * 1024];
+		mem_bytes = memsize * 1024 * 1024;
+		AllocateBase(section->Get_bool("memhugepages"));
 		if (!MemBase) {
 			E_Exit("Can't allocate main memory of %u MB", memsize);
 		}
-		memset((void*)MemBase, 0, memsize * 1024 * 1024);
 		memory.pages = (memsize * 1024 * 1024) / 4096;
 		LOG_MSG("MEMORY: Base address: %p", MemBase);
 		LOG_MSG("MEMORY: Using %d DOS memory pages (%u MiB)",
@@ -582,6 +978,9 @@ public:
 			       sizeof(PageHandler*) * memory.pages);
 		}
 
+		MemDirtyTracking = false;
+		memory.dirty.bits = nullptr;
+
 		memory.mhandles = new (std::nothrow) MemHandle [memory.pages];
 		if (!memory.mhandles) {
 			E_Exit("Can't allocate %" PRIuPTR " bytes worth of memory handles",
@@ -612,13 +1011,20 @@ public:
 		WriteHandler.Install(0x92,write_p92,IO_MB);
 		ReadHandler.Install(0x92,read_p92,IO_MB);
 		MEM_A20_Enable(false);
+		SNAPSHOT_Register("memory", 2, MEM_SaveState, MEM_LoadState);
 	}
 
 	~MEMORY()
 	{
-		delete [] MemBase;
+#if (C_HAVE_MPROTECT) && defined(MAP_ANONYMOUS)
+		if (mem_mapped)
+			munmap(MemBase, mem_bytes);
+		else
+#endif
+			delete [] MemBase;
 		delete [] memory.phandlers;
 		delete [] memory.mhandles;
+		delete [] memory.dirty.bits;
 	}
 };
 
@@ -17,14 +17,22 @@
  */
 
 #include "dosbox.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "inout.h"
 #include "cpu.h"
 #include "callback.h"
 #include "pic.h"
 #include "timer.h"
 #include "setup.h"
+#include "snapshot.h"
 
+/* Initial size of the event pool, it grows when more events are pending */
 #define PIC_QUEUESIZE 512
+#define PIC_NOT_QUEUED (~(Bitu)0)
 
 struct PIC_Controller {
 	Bitu icw_words;
@@ -164,17 +172,24 @@ void PIC_Controller::start_irq(Bit8u val){
 }
 
 
+/* Pending events are kept in a binary min heap of pool slots, ordered by
+ * time and then by the order they were added in. The time is absolute in
+ * milliseconds (PIC_Ticks plus the fraction of the current tick), so it
+ * doesn't have to be adjusted every tick. */
 struct PICEntry {
-	float index;
+	double index;
+	Bit64u order;
 	Bitu value;
 	PIC_EventHandler pic_event;
-	PICEntry * next;
+	Bit32u generation;
+	Bitu heap_pos;
 };
 
 static struct {
-	PICEntry entries[PIC_QUEUESIZE];
-	PICEntry * free_entry;
-	PICEntry * next_entry;
+	std::vector<PICEntry> entries;
+	std::vector<Bitu> free_slots;
+	std::vector<Bitu> heap;
+	Bit64u order;
 } pic_queue;
 
 static void write_command(Bitu port,Bitu val,Bitu iolen) {
@@ -378,102 +393,143 @@ void PIC_SetIRQMask(Bitu irq, bool masked) {
 	pic->set_imr(newmask);
 }
 
-static void AddEntry(PICEntry * entry) {
-	PICEntry * find_entry=pic_queue.next_entry;
-	if (GCC_UNLIKELY(find_entry ==0)) {
-		entry->next=0;
-		pic_queue.next_entry=entry;
-	} else if (find_entry->index>entry->index) {
-		pic_queue.next_entry=entry;
-		entry->next=find_entry;
-	} else while (find_entry) {
-		if (find_entry->next) {
-			/* See if the next index comes later than this one */
-			if (find_entry->next->index > entry->index) {
-				entry->next=find_entry->next;
-				find_entry->next=entry;
-				break;
-			} else {
-				find_entry=find_entry->next;
-			}
-		} else {
-			entry->next=find_entry->next;
-			find_entry->next=entry;
-			break;
-		}
+static INLINE bool EventBefore(const PICEntry & a,const PICEntry & b) {
+	return (a.index<b.index) || (a.index==b.index && a.order<b.order);
+}
+
+static INLINE void HeapPlace(Bitu pos,Bitu slot) {
+	pic_queue.heap[pos]=slot;
+	pic_queue.entries[slot].heap_pos=pos;
+}
+
+static void HeapUp(Bitu pos) {
+	const Bitu slot=pic_queue.heap[pos];
+	while (pos) {
+		const Bitu parent=(pos-1)/2;
+		if (!EventBefore(pic_queue.entries[slot],pic_queue.entries[pic_queue.heap[parent]])) break;
+		HeapPlace(pos,pic_queue.heap[parent]);
+		pos=parent;
 	}
-	Bits cycles=PIC_MakeCycles(pic_queue.next_entry->index-PIC_TickIndex());
-	if (cycles<CPU_Cycles) {
-		CPU_CycleLeft+=CPU_Cycles;
-		CPU_Cycles=0;
+	HeapPlace(pos,slot);
+}
+
+static void HeapDown(Bitu pos) {
+	const Bitu slot=pic_queue.heap[pos];
+	const Bitu size=pic_queue.heap.size();
+	for (;;) {
+		Bitu child=2*pos+1;
+		if (child>=size) break;
+		if (child+1<size && EventBefore(pic_queue.entries[pic_queue.heap[child+1]],pic_queue.entries[pic_queue.heap[child]])) child++;
+		if (!EventBefore(pic_queue.entries[pic_queue.heap[child]],pic_queue.entries[slot])) break;
+		HeapPlace(pos,pic_queue.heap[child]);
+		pos=child;
 	}
+	HeapPlace(pos,slot);
+}
+
+/* Return a slot to the pool, outstanding handles to it become stale */
+static void FreeEntry(Bitu slot) {
+	PICEntry & entry=pic_queue.entries[slot];
+	entry.heap_pos=PIC_NOT_QUEUED;
+	if (GCC_UNLIKELY(++entry.generation==0)) entry.generation=1;
+	pic_queue.free_slots.push_back(slot);
 }
-static bool InEventService = false;
-static float srv_lag = 0;
 
-void PIC_AddEvent(PIC_EventHandler handler,float delay,Bitu val) {
-	if (GCC_UNLIKELY(!pic_queue.free_entry)) {
-		LOG(LOG_PIC,LOG_ERROR)("Event queue full");
-		return;
+static void RemoveEntry(Bitu slot) {
+	const Bitu pos=pic_queue.entries[slot].heap_pos;
+	const Bitu last=pic_queue.heap.back();
+	pic_queue.heap.pop_back();
+	if (last!=slot) {
+		HeapPlace(pos,last);
+		HeapUp(pos);
+		HeapDown(pic_queue.entries[last].heap_pos);
 	}
-	PICEntry * entry=pic_queue.free_entry;
-	if(InEventService) entry->index = delay + srv_lag;
-	else entry->index = delay + PIC_TickIndex();
+	FreeEntry(slot);
+}
 
-	entry->pic_event=handler;
-	entry->value=val;
-	pic_queue.free_entry=pic_queue.free_entry->next;
-	AddEntry(entry);
+/* Drop the matching events and rebuild the heap from what is left */
+static void RemoveMatching(PIC_EventHandler handler,bool match_value,Bitu val) {
+	Bitu kept=0;
+	for (Bitu i=0;i<pic_queue.heap.size();i++) {
+		const Bitu slot=pic_queue.heap[i];
+		const PICEntry & entry=pic_queue.entries[slot];
+		if (entry.pic_event==handler && (!match_value || entry.value==val)) FreeEntry(slot);
+		else pic_queue.heap[kept++]=slot;
+	}
+	if (kept==pic_queue.heap.size()) return;
+	pic_queue.heap.resize(kept);
+	for (Bitu pos=0;pos<kept;pos++) pic_queue.entries[pic_queue.heap[pos]].heap_pos=pos;
+	for (Bitu pos=kept/2;pos-->0;) HeapDown(pos);
 }
 
-void PIC_RemoveSpecificEvents(PIC_EventHandler handler, Bitu val) {
-	PICEntry * entry=pic_queue.next_entry;
-	PICEntry * prev_entry;
-	prev_entry = 0;
-	while (entry) {
-		if (GCC_UNLIKELY((entry->pic_event == handler)) && (entry->value == val)) {
-			if (prev_entry) {
-				prev_entry->next=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=prev_entry->next;
-				continue;
-			} else {
-				pic_queue.next_entry=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=pic_queue.next_entry;
-				continue;
-			}
+static Bitu AllocEntry(void) {
+	if (GCC_UNLIKELY(pic_queue.free_slots.empty())) {
+		PICEntry entry;
+		entry.generation=1;
+		entry.heap_pos=PIC_NOT_QUEUED;
+		pic_queue.entries.push_back(entry);
+		return pic_queue.entries.size()-1;
+	}
+	const Bitu slot=pic_queue.free_slots.back();
+	pic_queue.free_slots.pop_back();
+	return slot;
+}
+
+/* Cycles from the given position in the tick to the first pending event,
+ * the running slice of the core ends there */
+static INLINE Bits NextEventCycles(Bits index_nd) {
+	const double next=pic_queue.entries[pic_queue.heap[0]].index-(double)PIC_Ticks;
+	return (Bits)(next*CPU_CycleMax-index_nd);
+}
+
+static bool InEventService = false;
+static double srv_lag = 0;
+
+PIC_EventHandle PIC_AddEvent(PIC_EventHandler handler,double delay,Bitu val) {
+	const Bitu slot=AllocEntry();
+	PICEntry & entry=pic_queue.entries[slot];
+	if(InEventService) entry.index = delay + srv_lag;
+	else entry.index = delay + (double)PIC_Ticks + PIC_TickIndex();
+
+	entry.order=pic_queue.order++;
+	entry.pic_event=handler;
+	entry.value=val;
+	pic_queue.heap.push_back(slot);
+	HeapUp(pic_queue.heap.size()-1);
+
+	/* A new first event moves the end of the running slice forward, the
+	   core keeps going up to exactly that point instead of stopping now */
+	if (entry.heap_pos==0) {
+		Bits cycles=NextEventCycles(PIC_TickIndexND());
+		if (cycles<CPU_Cycles) {
+			if (cycles<0) cycles=0;
+			CPU_CycleLeft+=CPU_Cycles-cycles;
+			CPU_Cycles=cycles;
 		}
-		prev_entry=entry;
-		entry=entry->next;
-	}	
+	}
+	return ((PIC_EventHandle)entry.generation << 32) | slot;
+}
+
+void PIC_RemoveEvent(PIC_EventHandle handle) {
+	const Bitu slot=(Bitu)(handle & 0xffffffff);
+	if (slot>=pic_queue.entries.size()) return;
+	const PICEntry & entry=pic_queue.entries[slot];
+	if (entry.generation!=(Bit32u)(handle >> 32) || entry.heap_pos==PIC_NOT_QUEUED) return;
+	RemoveEntry(slot);
+}
+
+bool PIC_NextEventDelay(double & delay) {
+	if (pic_queue.heap.empty()) return false;
+	delay=pic_queue.entries[pic_queue.heap[0]].index-PIC_FullIndex();
+	return true;
+}
+
+void PIC_RemoveSpecificEvents(PIC_EventHandler handler, Bitu val) {
+	RemoveMatching(handler,true,val);
 }
 
 void PIC_RemoveEvents(PIC_EventHandler handler) {
-	PICEntry * entry=pic_queue.next_entry;
-	PICEntry * prev_entry;
-	prev_entry=0;
-	while (entry) {
-		if (GCC_UNLIKELY(entry->pic_event==handler)) {
-			if (prev_entry) {
-				prev_entry->next=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=prev_entry->next;
-				continue;
-			} else {
-				pic_queue.next_entry=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=pic_queue.next_entry;
-				continue;
-			}
-		}
-		prev_entry=entry;
-		entry=entry->next;
-	}	
+	RemoveMatching(handler,false,0);
 }
 
 
@@ -487,22 +543,22 @@ bool PIC_RunQueue(void) {
 	/* Check the queue for an entry */
 	Bits index_nd=PIC_TickIndexND();
 	InEventService = true;
-	while (pic_queue.next_entry && (pic_queue.next_entry->index*CPU_CycleMax<=index_nd)) {
-		PICEntry * entry=pic_queue.next_entry;
-		pic_queue.next_entry=entry->next;
-
-		srv_lag = entry->index;
-		(entry->pic_event)(entry->value); // call the event handler
-
-		/* Put the entry in the free list */
-		entry->next=pic_queue.free_entry;
-		pic_queue.free_entry=entry;
+	while (!pic_queue.heap.empty()) {
+		const Bitu slot=pic_queue.heap[0];
+		const PICEntry & entry=pic_queue.entries[slot];
+		if ((entry.index-(double)PIC_Ticks)*CPU_CycleMax>index_nd) break;
+		const PIC_EventHandler pic_event=entry.pic_event;
+		const Bitu value=entry.value;
+		srv_lag = entry.index;
+		/* Take it off the queue first, the handler may add or remove events */
+		RemoveEntry(slot);
+		pic_event(value); // call the event handler
 	}
 	InEventService = false;
 
 	/* Check when to set the new cycle end */
-	if (pic_queue.next_entry) {
-		Bits cycles=(Bits)(pic_queue.next_entry->index*CPU_CycleMax-index_nd);
+	if (!pic_queue.heap.empty()) {
+		Bits cycles=NextEventCycles(index_nd);
 		if (GCC_UNLIKELY(!cycles)) cycles=1;
 		if (cycles<CPU_CycleLeft) {
 			CPU_Cycles=cycles;
@@ -515,6 +571,112 @@ bool PIC_RunQueue(void) {
 	return true;
 }
 
+struct PIC_SnapshotEvent {
+	std::string name;
+	PIC_EventHandler handler;
+};
+
+static std::vector<PIC_SnapshotEvent> snapshot_events;
+
+void PIC_RegisterSnapshotEvent(const char *name, PIC_EventHandler handler) {
+	for (auto & event : snapshot_events) {
+		if (event.name==name) {
+			event.handler=handler;
+			return;
+		}
+	}
+	snapshot_events.push_back({name,handler});
+}
+
+static Bitu FindSnapshotEvent(PIC_EventHandler handler) {
+	for (Bitu i=0;i<snapshot_events.size();i++) {
+		if (snapshot_events[i].handler==handler) return i;
+	}
+	return snapshot_events.size();
+}
+
+/* Snapshots are taken between two ticks, the saved events keep their time
+ * and the order they run in, the kept ones move along with PIC_Ticks */
+static void PIC_SaveState(SnapshotWriter &out) {
+	out.Write(static_cast<Bit32u>(sizeof(pics)));
+	out.Write(pics);
+	out.Write(static_cast<Bit32u>(PIC_Ticks));
+	out.Write(static_cast<Bit32u>(PIC_IRQCheck));
+	out.Write(CPU_Cycles);
+	out.Write(CPU_CycleLeft);
+
+	std::vector<Bitu> slots;
+	for (Bitu slot : pic_queue.heap) {
+		if (FindSnapshotEvent(pic_queue.entries[slot].pic_event)<snapshot_events.size()) slots.push_back(slot);
+	}
+	std::sort(slots.begin(),slots.end(),[](Bitu a,Bitu b) {
+		return EventBefore(pic_queue.entries[a],pic_queue.entries[b]);
+	});
+	out.Write(static_cast<Bit32u>(slots.size()));
+	for (Bitu slot : slots) {
+		const PICEntry & entry=pic_queue.entries[slot];
+		const std::string & name=snapshot_events[FindSnapshotEvent(entry.pic_event)].name;
+		out.Write(static_cast<Bit8u>(name.size()));
+		out.Write(name.data(),name.size());
+		out.Write(entry.index);
+		out.Write(static_cast<Bit64u>(entry.value));
+	}
+}
+
+static bool PIC_LoadState(SnapshotReader &in,bool apply) {
+	Bit32u size,ticks,irq_check,count;
+	Bit32s cycles,cycle_left;
+	if (!in.Read(size) || size!=sizeof(pics)) return false;
+	PIC_Controller saved_pics[2];
+	if (!in.Read(saved_pics) || !in.Read(ticks) || !in.Read(irq_check) ||
+		!in.Read(cycles) || !in.Read(cycle_left) || !in.Read(count)) return false;
+
+	struct SavedEvent {
+		PIC_EventHandler handler;
+		double index;
+		Bit64u value;
+	};
+	std::vector<SavedEvent> events;
+	for (Bit32u i=0;i<count;i++) {
+		Bit8u length;
+		std::string name;
+		SavedEvent event;
+		if (!in.Read(length)) return false;
+		name.resize(length);
+		if (!in.Read(&name[0],length) || !in.Read(event.index) || !in.Read(event.value)) return false;
+		Bitu known=0;
+		while (known<snapshot_events.size() && snapshot_events[known].name!=name) known++;
+		if (known==snapshot_events.size()) {
+			LOG_MSG("PIC: Snapshot has an event for %s, which this configuration lacks",name.c_str());
+			return false;
+		}
+		event.handler=snapshot_events[known].handler;
+		events.push_back(event);
+	}
+	if (!apply) return true;
+
+	for (const auto & event : snapshot_events) RemoveMatching(event.handler,false,0);
+	/* Moving every kept event by the same amount keeps the heap valid */
+	const double shift=(double)ticks-(double)PIC_Ticks;
+	for (Bitu slot : pic_queue.heap) pic_queue.entries[slot].index+=shift;
+	for (const auto & event : events) {
+		const Bitu slot=AllocEntry();
+		PICEntry & entry=pic_queue.entries[slot];
+		entry.index=event.index;
+		entry.order=pic_queue.order++;
+		entry.pic_event=event.handler;
+		entry.value=(Bitu)event.value;
+		pic_queue.heap.push_back(slot);
+		HeapUp(pic_queue.heap.size()-1);
+	}
+	memcpy(pics,saved_pics,sizeof(pics));
+	PIC_Ticks=ticks;
+	PIC_IRQCheck=irq_check;
+	CPU_Cycles=cycles;
+	CPU_CycleLeft=cycle_left;
+	return true;
+}
+
 /* The TIMER Part */
 struct TickerBlock {
 	TIMER_TickHandler handler;
@@ -550,12 +712,6 @@ void TIMER_AddTick(void) {
 	CPU_CycleLeft=CPU_CycleMax;
 	CPU_Cycles=0;
 	PIC_Ticks++;
-	/* Go through the list of scheduled events and lower their index with 1000 */
-	PICEntry * entry=pic_queue.next_entry;
-	while (entry) {
-		entry->index -= 1.0;
-		entry=entry->next;
-	}
 	/* Call our list of ticker handlers */
 	TickerBlock * ticker=firstticker;
 	while (ticker) {
@@ -609,12 +765,14 @@ public:
 		WriteHandler[2].Install(0xa0,write_command,IO_MB);
 		WriteHandler[3].Install(0xa1,write_data,IO_MB);
 		/* Initialize the pic queue */
-		for (i=0;i<PIC_QUEUESIZE-1;i++) {
-			pic_queue.entries[i].next=&pic_queue.entries[i+1];
-		}
-		pic_queue.entries[PIC_QUEUESIZE-1].next=0;
-		pic_queue.free_entry=&pic_queue.entries[0];
-		pic_queue.next_entry=0;
+		pic_queue.entries.clear();
+		pic_queue.free_slots.clear();
+		pic_queue.heap.clear();
+		pic_queue.entries.reserve(PIC_QUEUESIZE);
+		pic_queue.free_slots.reserve(PIC_QUEUESIZE);
+		pic_queue.heap.reserve(PIC_QUEUESIZE);
+		pic_queue.order=0;
+		SNAPSHOT_Register("pic",1,PIC_SaveState,PIC_LoadState);
 	}
 
 	~PIC_8259A(){
@@ -31,6 +31,7 @@
 #include "support.h"
 #include "shell.h"
 #include "midi.h"
+#include "snapshot.h"
 
 using namespace std;
 
@@ -1636,6 +1637,85 @@ static void SBLASTER_CallBack(Bitu len) {
 	}
 }
 
+/* The dma transfer state, its pending events and the dma channel callbacks
+ * are saved, the samples the mixer still has to play are not */
+static const process_dma_f dma_transfers[]={&PlayDMATransfer,&SuppressInitialDMATransfer,&SuppressDMATransfer};
+
+typedef void (*sb_dma_callback_f)(DmaChannel *,DMAEvent);
+static const sb_dma_callback_f dma_callbacks[]={0,&DSP_DMA_CallBack,&DSP_E2_DMA_CallBack,&DSP_ADC_CallBack};
+
+static Bit8u SB_DMACallbackIndex(DmaChannel * chan) {
+	if (!chan->callback) return 0;
+	const sb_dma_callback_f * target=chan->callback.target<sb_dma_callback_f>();
+	for (Bit8u i=1;target && i<sizeof(dma_callbacks)/sizeof(dma_callbacks[0]);i++) {
+		if (*target==dma_callbacks[i]) return i;
+	}
+	return 0xff;	// belongs to another device on the same channel
+}
+
+static void SB_SaveState(SnapshotWriter &out) {
+	out.Write(static_cast<Bit32u>(sizeof(SB_INFO)));
+	out.Write(sb);
+	out.Write(static_cast<Bit8u>(sb.dma.chan ? sb.dma.chan->channum : 0xff));
+	Bit8u transfer=0;
+	while (transfer<2 && dma_transfers[transfer]!=ProcessDMATransfer) transfer++;
+	out.Write(transfer);
+	out.Write(ASP_regs);
+	out.Write(ASP_init_in_progress);
+	out.Write(last_dma_callback);
+	out.Write(sb.chan->is_enabled);
+	out.Write(sb.chan->GetSampleRate());
+	for (Bit8u dma : {sb.hw.dma8,sb.hw.dma16}) {
+		DmaChannel * chan=GetDMAChannel(dma);
+		out.Write(static_cast<Bit8u>(chan ? SB_DMACallbackIndex(chan) : 0));
+	}
+}
+
+static bool SB_LoadState(SnapshotReader &in,bool apply) {
+	Bit32u size;
+	if (!in.Read(size) || size!=sizeof(SB_INFO)) return false;
+	static SB_INFO saved;	// too big for the stack with the dma buffer
+	Bit8u dma_channel,transfer;
+	Bit8u asp_regs[256];
+	bool asp_init,enabled;
+	double dma_callback;
+	Bit32u sample_rate;
+	Bit8u callback[2];
+	if (!in.Read(saved) || !in.Read(dma_channel) || !in.Read(transfer) ||
+		!in.Read(asp_regs) || !in.Read(asp_init) || !in.Read(dma_callback) ||
+		!in.Read(enabled) || !in.Read(sample_rate) || !in.Read(callback)) return false;
+	if (saved.type!=sb.type || saved.hw.base!=sb.hw.base || saved.hw.irq!=sb.hw.irq ||
+		saved.hw.dma8!=sb.hw.dma8 || saved.hw.dma16!=sb.hw.dma16) {
+		LOG_MSG("%s: Snapshot has a different sound blaster configuration",CardType());
+		return false;
+	}
+	if (transfer>2 || (dma_channel!=0xff && !GetDMAChannel(dma_channel))) return false;
+	if (!apply) return true;
+
+	MixerChannel * mixer_chan=sb.chan;
+	sb=saved;
+	sb.chan=mixer_chan;
+	sb.dma.chan=(dma_channel!=0xff) ? GetDMAChannel(dma_channel) : NULL;
+	ProcessDMATransfer=dma_transfers[transfer];
+	memcpy(ASP_regs,asp_regs,sizeof(ASP_regs));
+	ASP_init_in_progress=asp_init;
+	last_dma_callback=dma_callback;
+	/* Set without the mask event, the dma state is already restored */
+	const Bit8u dmas[2]={sb.hw.dma8,sb.hw.dma16};
+	for (int i=0;i<2;i++) {
+		DmaChannel * chan=GetDMAChannel(dmas[i]);
+		if (!chan || callback[i]==0xff) continue;
+		const Bit8u current=SB_DMACallbackIndex(chan);
+		if (current==callback[i] || (current==0xff && !callback[i])) continue;
+		if (callback[i]) chan->callback=dma_callbacks[callback[i]];
+		else chan->callback=nullptr;
+	}
+	sb.chan->SetFreq(sample_rate);
+	sb.chan->Enable(enabled);
+	CTMIXER_UpdateVolumes();
+	return true;
+}
+
 class SBLASTER: public Module_base {
 private:
 	/* Data */
@@ -1762,6 +1842,13 @@ public:
 		/* Soundblaster midi interface */
 		if (!MIDI_Available()) sb.midi = false;
 		else sb.midi = true;
+
+		PIC_RegisterSnapshotEvent("sb_irq",DSP_RaiseIRQEvent);
+		PIC_RegisterSnapshotEvent("sb_reset",DSP_FinishReset);
+		PIC_RegisterSnapshotEvent("sb_dma_play",PlayDMATransfer);
+		PIC_RegisterSnapshotEvent("sb_dma_suppress_initial",SuppressInitialDMATransfer);
+		PIC_RegisterSnapshotEvent("sb_dma_suppress",SuppressDMATransfer);
+		SNAPSHOT_Register("sblaster",1,SB_SaveState,SB_LoadState);
 	}	
 	
 	~SBLASTER() {
@@ -1781,6 +1868,7 @@ public:
 			break;
 		}
 		if (sb.type==SBT_NONE || sb.type==SBT_GB) return;
+		SNAPSHOT_Unregister("sblaster");
 		DSP_Reset(); // Stop everything	
 	}	
 }; //End of SBLASTER class
@@ -25,6 +25,7 @@
 #include "mixer.h"
 #include "timer.h"
 #include "setup.h"
+#include "snapshot.h"
 
 static INLINE void BIN2BCD(Bit16u& val) {
 	Bit16u temp=val%10 + (((val/10)%10)<<4)+ (((val/100)%10)<<8) + (((val/1000)%10)<<12);
@@ -412,6 +413,29 @@ bool TIMER_GetOutput2(void) {
 	return counter_output(2);
 }
 
+/* The counter start times are absolute like the PIC event times, the PIC
+ * state restores PIC_Ticks and the pending PIT0_Event */
+static void TIMER_SaveState(SnapshotWriter &out) {
+	out.Write(static_cast<Bit32u>(sizeof(pit)));
+	out.Write(pit);
+	out.Write(gate2);
+	out.Write(latched_timerstatus);
+	out.Write(latched_timerstatus_locked);
+}
+
+static bool TIMER_LoadState(SnapshotReader &in,bool apply) {
+	Bit32u size;
+	if (!in.Read(size) || size!=sizeof(pit)) return false;
+	if (!apply) return in.Skip(size+sizeof(gate2)+sizeof(latched_timerstatus)+sizeof(latched_timerstatus_locked));
+	in.Read(pit);
+	in.Read(gate2);
+	in.Read(latched_timerstatus);
+	in.Read(latched_timerstatus_locked);
+	/* Counter 2 drives the pc speaker */
+	PCSPEAKER_SetCounter(pit[2].cntr,pit[2].mode);
+	return true;
+}
+
 class TIMER:public Module_base{
 private:
 	IO_ReadHandleObject ReadHandler[4];
@@ -463,6 +487,8 @@ public:
 		latched_timerstatus_locked=false;
 		gate2 = false;
 		PIC_AddEvent(PIT0_Event,pit[0].delay);
+		PIC_RegisterSnapshotEvent("pit0",PIT0_Event);
+		SNAPSHOT_Register("pit",1,TIMER_SaveState,TIMER_LoadState);
 	}
 	~TIMER(){
 		PIC_RemoveEvents(PIT0_Event);
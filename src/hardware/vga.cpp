@@ -21,7 +21,9 @@
 #include <cassert>
 #include <cstring>
 
+#include "mem.h"
 #include "pic.h"
+#include "snapshot.h"
 #include "video.h"
 
 VGA_Type vga;
@@ -173,6 +175,149 @@ void VGA_SetCGA4Table(Bit8u val0,Bit8u val1,Bit8u val2,Bit8u val3) {
 	}	
 }
 
+/* The register groups are saved raw, the host pointers in them are saved
+ * as offsets and the drawing is restarted from the restored registers. */
+static const Bit32u vga_state_size=sizeof(VGAModes)+sizeof(Bit8u)+
+	sizeof(VGA_Config)+sizeof(VGA_Internal)+sizeof(VGA_Seq)+sizeof(VGA_Attr)+
+	sizeof(VGA_Crtc)+sizeof(VGA_Gfx)+sizeof(VGA_Dac)+sizeof(VGA_Latch)+
+	sizeof(VGA_S3)+sizeof(VGA_SVGA)+sizeof(VGA_HERC)+sizeof(VGA_TANDY)+
+	sizeof(VGA_OTHER)+sizeof(vga.draw.font)+sizeof(vga.draw.cursor)+
+	sizeof(vga.draw.blinking)+sizeof(vga.draw.blink)+sizeof(vga.draw.char9dot)+
+	sizeof(CGA_2_Table)+sizeof(CGA_4_Table)+sizeof(CGA_4_HiRes_Table)+
+	sizeof(CGA_16_Table)+sizeof(TXT_BG_Table);
+
+/* Tandy and PCjr video memory is either in the vga memory or in main memory */
+enum {VGA_BASE_NONE,VGA_BASE_LINEAR,VGA_BASE_MEMBASE};
+
+static void VGA_WriteBase(SnapshotWriter &out,const Bit8u *base) {
+	Bit8u region=VGA_BASE_NONE;
+	Bit32u offset=0;
+	if (base>=vga.mem.linear && base<vga.mem.linear+vga.vmemsize) {
+		region=VGA_BASE_LINEAR;
+		offset=(Bit32u)(base-vga.mem.linear);
+	} else if (base>=MemBase && base<MemBase+MEM_TotalPages()*MEM_PAGESIZE) {
+		region=VGA_BASE_MEMBASE;
+		offset=(Bit32u)(base-MemBase);
+	}
+	out.Write(region);
+	out.Write(offset);
+}
+
+static bool VGA_ReadBase(SnapshotReader &in,Bit8u **base) {
+	Bit8u region;
+	Bit32u offset;
+	if (!in.Read(region) || !in.Read(offset)) return false;
+	switch (region) {
+	case VGA_BASE_NONE:
+		if (base) *base=0;
+		return true;
+	case VGA_BASE_LINEAR:
+		if (offset>=vga.vmemsize) return false;
+		if (base) *base=vga.mem.linear+offset;
+		return true;
+	case VGA_BASE_MEMBASE:
+		if (offset>=MEM_TotalPages()*MEM_PAGESIZE) return false;
+		if (base) *base=MemBase+offset;
+		return true;
+	}
+	return false;
+}
+
+static void VGA_SaveState(SnapshotWriter &out) {
+	out.Write(vga.vmemsize);
+	out.Write(vga_state_size);
+	out.Write(vga.mode);
+	out.Write(vga.misc_output);
+	out.Write(vga.config);
+	out.Write(vga.internal);
+	out.Write(vga.seq);
+	out.Write(vga.attr);
+	out.Write(vga.crtc);
+	out.Write(vga.gfx);
+	out.Write(vga.dac);
+	out.Write(vga.latch);
+	out.Write(vga.s3);
+	out.Write(vga.svga);
+	out.Write(vga.herc);
+	out.Write(vga.tandy);
+	out.Write(vga.other);
+	out.Write(vga.draw.font);
+	out.Write(vga.draw.cursor);
+	out.Write(vga.draw.blinking);
+	out.Write(vga.draw.blink);
+	out.Write(vga.draw.char9dot);
+	out.Write(CGA_2_Table);
+	out.Write(CGA_4_Table);
+	out.Write(CGA_4_HiRes_Table);
+	out.Write(CGA_16_Table);
+	out.Write(TXT_BG_Table);
+	VGA_WriteBase(out,vga.tandy.draw_base);
+	VGA_WriteBase(out,vga.tandy.mem_base);
+	for (const Bit8u * table : vga.draw.font_tables)
+		out.Write(static_cast<Bit32u>(table-vga.draw.font));
+	SNAPSHOT_WriteBlock(out,vga.mem.linear,vga.vmemsize);
+	SNAPSHOT_WriteBlock(out,vga.fastmem,vga.vmemsize<<1);
+}
+
+static bool VGA_LoadState(SnapshotReader &in,bool apply) {
+	Bit32u vmemsize,size;
+	if (!in.Read(vmemsize) || !in.Read(size)) return false;
+	if (vmemsize!=vga.vmemsize) {
+		LOG_MSG("VGA: Snapshot has %d KB of video memory instead of %d KB",vmemsize/1024,vga.vmemsize/1024);
+		return false;
+	}
+	if (size!=vga_state_size) return false;
+	if (!apply) {
+		Bit32u font_table[2];
+		if (!in.Skip(size) || !VGA_ReadBase(in,0) || !VGA_ReadBase(in,0) ||
+			!in.Read(font_table)) return false;
+		for (Bit32u offset : font_table) {
+			if (offset>=sizeof(vga.draw.font)) return false;
+		}
+		return SNAPSHOT_ReadBlock(in,0,vmemsize) && SNAPSHOT_ReadBlock(in,0,vmemsize<<1);
+	}
+	in.Read(vga.mode);
+	in.Read(vga.misc_output);
+	in.Read(vga.config);
+	in.Read(vga.internal);
+	in.Read(vga.seq);
+	in.Read(vga.attr);
+	in.Read(vga.crtc);
+	in.Read(vga.gfx);
+	in.Read(vga.dac);
+	in.Read(vga.latch);
+	in.Read(vga.s3);
+	in.Read(vga.svga);
+	in.Read(vga.herc);
+	in.Read(vga.tandy);
+	in.Read(vga.other);
+	in.Read(vga.draw.font);
+	in.Read(vga.draw.cursor);
+	in.Read(vga.draw.blinking);
+	in.Read(vga.draw.blink);
+	in.Read(vga.draw.char9dot);
+	in.Read(CGA_2_Table);
+	in.Read(CGA_4_Table);
+	in.Read(CGA_4_HiRes_Table);
+	in.Read(CGA_16_Table);
+	in.Read(TXT_BG_Table);
+	VGA_ReadBase(in,&vga.tandy.draw_base);
+	VGA_ReadBase(in,&vga.tandy.mem_base);
+	for (Bit8u * &table : vga.draw.font_tables) {
+		Bit32u offset;
+		in.Read(offset);
+		table=vga.draw.font+offset;
+	}
+	SNAPSHOT_ReadBlock(in,vga.mem.linear,vmemsize);
+	SNAPSHOT_ReadBlock(in,vga.fastmem,vmemsize<<1);
+
+	VGA_SetupHandlers();
+	if (svgaCard==SVGA_S3Trio) VGA_StartUpdateLFB();
+	VGA_DACSetEntirePalette();
+	VGA_RestartDrawing();
+	return true;
+}
+
 void VGA_Init(Section* sec) {
 //	Section_prop * section=static_cast<Section_prop *>(sec);
 	vga.draw.resizing=false;
@@ -239,6 +384,7 @@ void VGA_Init(Section* sec) {
 #endif
 		}
 	}
+	SNAPSHOT_Register("vga",1,VGA_SaveState,VGA_LoadState);
 }
 
 void SVGA_Setup_Driver(void) {
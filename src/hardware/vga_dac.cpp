@@ -197,6 +197,23 @@ void VGA_DAC_SetEntry(Bitu entry,Bit8u red,Bit8u green,Bit8u blue) {
 			VGA_DAC_SendColor( i, i );
 }
 
+void VGA_DACSetEntirePalette(void) {
+	//Sends the whole palette to the renderer again, like after a snapshot load
+	switch (vga.mode) {
+	case M_LIN8:
+		for (Bitu i=0;i<256;i++)
+			VGA_DAC_UpdateColor( i );
+		break;
+	case M_VGA:
+		for (Bitu i=0;i<256;i++)
+			VGA_DAC_UpdateColor( i );
+		if(!IS_VGA_ARCH || (svgaCard!=SVGA_None)) break;
+	default:
+		for (Bitu i=0;i<16;i++)
+			VGA_DAC_SendColor( i, vga.dac.combine[i] );
+	}
+}
+
 void VGA_SetupDAC(void) {
 	vga.dac.first_changed=256;
 	vga.dac.bits=6;
@@ -1617,6 +1617,20 @@ void VGA_KillDrawing(void) {
 	if (!vga.draw.vga_override) RENDER_EndUpdate(true);
 }
 
+void VGA_RestartDrawing(void) {
+	VGA_KillDrawing();
+	PIC_RemoveEvents(VGA_SetupDrawing);
+	PIC_RemoveEvents(VGA_Other_VertInterrupt);
+	PIC_RemoveEvents(VGA_VerticalTimer);
+	PIC_RemoveEvents(VGA_PanningLatch);
+	PIC_RemoveEvents(VGA_DisplayStartLatch);
+	PIC_RemoveEvents(VGA_VertInterrupt);
+	vga.draw.resizing=false;
+	vga.draw.delay.vtotal=0;	// restarts the vertical timer
+	vga.draw.width=0;			// change it so the output window gets updated
+	VGA_SetupDrawing(0);
+}
+
 void VGA_SetOverride(bool vga_override) {
 	if (vga.draw.vga_override!=vga_override) {
 		
@@ -49,8 +49,12 @@
 #ifdef VGA_KEEP_CHANGES
 #define MEM_CHANGED( _MEM ) vga.changes.map[ (_MEM) >> VGA_CHANGE_SHIFT ] |= vga.changes.writeMask;
 //#define MEM_CHANGED( _MEM ) vga.changes.map[ (_MEM) >> VGA_CHANGE_SHIFT ] = 1;
+#define MEM_CHANGED_RANGE( _START, _END ) \
+	for (Bitu _m=(_START) >> VGA_CHANGE_SHIFT;_m<=((_END) >> VGA_CHANGE_SHIFT);_m++) \
+		vga.changes.map[_m] |= vga.changes.writeMask;
 #else
 #define MEM_CHANGED( _MEM ) 
+#define MEM_CHANGED_RANGE( _START, _END )
 #endif
 
 #define TANDY_VIDBASE(_X_)  &MemBase[ 0x80000 + (_X_)]
@@ -124,6 +128,63 @@ INLINE static Bit32u ModeOperation(Bit8u val) {
 	return full;
 }
 
+/* ModeOperation and the plane write for a run of bytes going to consecutive
+ * planar offsets. The write and raster modes are fixed for the run and the
+ * latch only changes on reads, so each combination gets its own loop of
+ * plain dword operations that the compiler can vectorize. */
+template <Bitu raster_op>
+static INLINE Bit32u RasterOpFixed(Bit32u input,Bit32u mask,Bit32u latch) {
+	switch (raster_op) {
+	case 0x00: return (input & mask) | (latch & ~mask);
+	case 0x01: return (input | ~mask) & latch;
+	case 0x02: return (input & mask) | latch;
+	default:   return (input & mask) ^ latch;
+	}
+}
+
+template <Bitu write_mode,Bitu raster_op>
+static void PlanarWrite(Bit32u * planes,const Bit8u * data,Bitu count) {
+	const Bit32u map_mask=vga.config.full_map_mask;
+	const Bit32u not_map_mask=vga.config.full_not_map_mask;
+	const Bit32u bit_mask=vga.config.full_bit_mask;
+	const Bit32u not_enable_set_reset=vga.config.full_not_enable_set_reset;
+	const Bit32u enable_and_set_reset=vga.config.full_enable_and_set_reset;
+	const Bit32u set_reset=vga.config.full_set_reset;
+	const Bit32u latch=vga.latch.d;
+	const Bitu rotate=vga.config.data_rotate;
+	for (Bitu i=0;i<count;i++) {
+		Bit32u val=data[i];
+		Bit32u full;
+		if (write_mode==0x01) {
+			full=latch;
+		} else if (write_mode==0x02) {
+			full=RasterOpFixed<raster_op>(FillTable[val&0xF],bit_mask,latch);
+		} else {
+			val=(Bit8u)((val >> rotate) | (val << (8-rotate)));
+			/* Same as ExpandTable[val] */
+			val*=0x01010101;
+			if (write_mode==0x00)
+				full=RasterOpFixed<raster_op>((val & not_enable_set_reset) | enable_and_set_reset,bit_mask,latch);
+			else
+				full=RasterOpFixed<raster_op>(set_reset,val & bit_mask,latch);
+		}
+		planes[i]=(planes[i] & not_map_mask) | (full & map_mask);
+	}
+}
+
+typedef void (* PlanarWriteHandler)(Bit32u * planes,const Bit8u * data,Bitu count);
+
+static const PlanarWriteHandler PlanarWriteTable[4][4]={
+	{ PlanarWrite<0,0>,PlanarWrite<0,1>,PlanarWrite<0,2>,PlanarWrite<0,3> },
+	{ PlanarWrite<1,0>,PlanarWrite<1,1>,PlanarWrite<1,2>,PlanarWrite<1,3> },
+	{ PlanarWrite<2,0>,PlanarWrite<2,1>,PlanarWrite<2,2>,PlanarWrite<2,3> },
+	{ PlanarWrite<3,0>,PlanarWrite<3,1>,PlanarWrite<3,2>,PlanarWrite<3,3> },
+};
+
+static INLINE void VGA_PlanarWrite(PhysPt start,const Bit8u * data,Bitu count) {
+	PlanarWriteTable[vga.config.write_mode&3][vga.config.raster_op&3](&((Bit32u*)vga.mem.linear)[start],data,count);
+}
+
 /* Gonna assume that whoever maps vga memory, maps it on 32/64kb boundary */
 
 #define VGA_PAGES		(128/4)
@@ -264,61 +325,69 @@ public:
 
 class VGA_UnchainedEGA_Handler : public VGA_UnchainedRead_Handler {
 public:
-	template< bool wrapping>
-	void writeHandler(PhysPt start, Bit8u val) {
-		Bit32u data=ModeOperation(val);
-		/* Update video memory and the pixel buffer */
-		VGA_Latch pixels;
-		pixels.d=((Bit32u*)vga.mem.linear)[start];
-		pixels.d&=vga.config.full_not_map_mask;
-		pixels.d|=(data & vga.config.full_map_mask);
-		((Bit32u*)vga.mem.linear)[start]=pixels.d;
-		Bit8u * write_pixels=&vga.fastmem[start<<3];
+	void writeHandler(PhysPt start,const Bit8u * data,Bitu count) {
+		VGA_PlanarWrite(start,data,count);
+		/* Update the pixel buffer */
+		for (PhysPt end=start+count;start<end;start++) {
+			VGA_Latch pixels;
+			pixels.d=((Bit32u*)vga.mem.linear)[start];
+			Bit8u * write_pixels=&vga.fastmem[start<<3];
 
-		Bit32u colors0_3, colors4_7;
-		VGA_Latch temp;temp.d=(pixels.d>>4) & 0x0f0f0f0f;
-			colors0_3 = 
-			Expand16Table[0][temp.b[0]] |
-			Expand16Table[1][temp.b[1]] |
-			Expand16Table[2][temp.b[2]] |
-			Expand16Table[3][temp.b[3]];
-		*(Bit32u *)write_pixels=colors0_3;
-		temp.d=pixels.d & 0x0f0f0f0f;
-		colors4_7 = 
-			Expand16Table[0][temp.b[0]] |
-			Expand16Table[1][temp.b[1]] |
-			Expand16Table[2][temp.b[2]] |
-			Expand16Table[3][temp.b[3]];
-		*(Bit32u *)(write_pixels+4)=colors4_7;
+			Bit32u colors0_3, colors4_7;
+			VGA_Latch temp;temp.d=(pixels.d>>4) & 0x0f0f0f0f;
+				colors0_3 = 
+				Expand16Table[0][temp.b[0]] |
+				Expand16Table[1][temp.b[1]] |
+				Expand16Table[2][temp.b[2]] |
+				Expand16Table[3][temp.b[3]];
+			*(Bit32u *)write_pixels=colors0_3;
+			temp.d=pixels.d & 0x0f0f0f0f;
+			colors4_7 = 
+				Expand16Table[0][temp.b[0]] |
+				Expand16Table[1][temp.b[1]] |
+				Expand16Table[2][temp.b[2]] |
+				Expand16Table[3][temp.b[3]];
+			*(Bit32u *)(write_pixels+4)=colors4_7;
+		}
 	}
 public:	
 	VGA_UnchainedEGA_Handler()  {
-		flags=PFLAG_NOCODE;
+		flags=PFLAG_NOCODE|PFLAG_WRITEBLOCK;
 	}
 	void writeb(PhysPt addr,Bitu val) {
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
 		MEM_CHANGED( addr << 3);
-		writeHandler<true>(addr+0,(Bit8u)(val >> 0));
+		Bit8u data=(Bit8u)val;
+		writeHandler(addr,&data,1);
 	}
 	void writew(PhysPt addr,Bitu val) {
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
 		MEM_CHANGED( addr << 3);
-		writeHandler<true>(addr+0,(Bit8u)(val >> 0));
-		writeHandler<true>(addr+1,(Bit8u)(val >> 8));
+		Bit8u data[2];
+		host_writew(data,(Bit16u)val);
+		writeHandler(addr,data,2);
 	}
 	void writed(PhysPt addr,Bitu val) {
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
 		MEM_CHANGED( addr << 3);
-		writeHandler<true>(addr+0,(Bit8u)(val >> 0));
-		writeHandler<true>(addr+1,(Bit8u)(val >> 8));
-		writeHandler<true>(addr+2,(Bit8u)(val >> 16));
-		writeHandler<true>(addr+3,(Bit8u)(val >> 24));
+		Bit8u data[4];
+		host_writed(data,(Bit32u)val);
+		writeHandler(addr,data,4);
+	}
+	bool writeblock(PhysPt addr,const Bit8u * data,Bitu count) {
+		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
+		addr += vga.svga.bank_write_full;
+		addr = CHECKED2(addr);
+		if (CHECKED2(addr+count-1)!=addr+count-1) return false;
+		MEM_CHANGED_RANGE( addr << 3, (addr+count-1) << 3);
+		writeHandler(addr,data,count);
+		return true;
 	}
 };
 
@@ -417,44 +486,49 @@ public:
 
 class VGA_UnchainedVGA_Handler : public VGA_UnchainedRead_Handler {
 public:
-	void writeHandler( PhysPt addr, Bit8u val ) {
-		Bit32u data=ModeOperation(val);
-		VGA_Latch pixels;
-		pixels.d=((Bit32u*)vga.mem.linear)[addr];
-		pixels.d&=vga.config.full_not_map_mask;
-		pixels.d|=(data & vga.config.full_map_mask);
-		((Bit32u*)vga.mem.linear)[addr]=pixels.d;
+	void writeHandler(PhysPt addr,const Bit8u * data,Bitu count) {
+		VGA_PlanarWrite(addr,data,count);
 //		if(vga.config.compatible_chain4)
 //			((Bit32u*)vga.mem.linear)[CHECKED2(addr+64*1024)]=pixels.d; 
 	}
 public:
 	VGA_UnchainedVGA_Handler()  {
-		flags=PFLAG_NOCODE;
+		flags=PFLAG_NOCODE|PFLAG_WRITEBLOCK;
 	}
 	void writeb(PhysPt addr,Bitu val) {
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
 		MEM_CHANGED( addr << 2 );
-		writeHandler(addr+0,(Bit8u)(val >> 0));
+		Bit8u data=(Bit8u)val;
+		writeHandler(addr,&data,1);
 	}
 	void writew(PhysPt addr,Bitu val) {
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
 		MEM_CHANGED( addr << 2);
-		writeHandler(addr+0,(Bit8u)(val >> 0));
-		writeHandler(addr+1,(Bit8u)(val >> 8));
+		Bit8u data[2];
+		host_writew(data,(Bit16u)val);
+		writeHandler(addr,data,2);
 	}
 	void writed(PhysPt addr,Bitu val) {
 		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
 		MEM_CHANGED( addr << 2);
-		writeHandler(addr+0,(Bit8u)(val >> 0));
-		writeHandler(addr+1,(Bit8u)(val >> 8));
-		writeHandler(addr+2,(Bit8u)(val >> 16));
-		writeHandler(addr+3,(Bit8u)(val >> 24));
+		Bit8u data[4];
+		host_writed(data,(Bit32u)val);
+		writeHandler(addr,data,4);
+	}
+	bool writeblock(PhysPt addr,const Bit8u * data,Bitu count) {
+		addr = PAGING_GetPhysicalAddress(addr) & vgapages.mask;
+		addr += vga.svga.bank_write_full;
+		addr = CHECKED2(addr);
+		if (CHECKED2(addr+count-1)!=addr+count-1) return false;
+		MEM_CHANGED_RANGE( addr << 2, (addr+count-1) << 2);
+		writeHandler(addr,data,count);
+		return true;
 	}
 };
 
@@ -556,29 +630,38 @@ public:
 class VGA_LIN4_Handler : public VGA_UnchainedEGA_Handler {
 public:
 	VGA_LIN4_Handler() {
-		flags=PFLAG_NOCODE;
+		flags=PFLAG_NOCODE|PFLAG_WRITEBLOCK;
 	}
 	void writeb(PhysPt addr,Bitu val) {
 		addr = vga.svga.bank_write_full + (PAGING_GetPhysicalAddress(addr) & 0xffff);
 		addr = CHECKED4(addr);
 		MEM_CHANGED( addr << 3 );
-		writeHandler<false>(addr+0,(Bit8u)(val >> 0));
+		Bit8u data=(Bit8u)val;
+		writeHandler(addr,&data,1);
 	}
 	void writew(PhysPt addr,Bitu val) {
 		addr = vga.svga.bank_write_full + (PAGING_GetPhysicalAddress(addr) & 0xffff);
 		addr = CHECKED4(addr);
 		MEM_CHANGED( addr << 3 );
-		writeHandler<false>(addr+0,(Bit8u)(val >> 0));
-		writeHandler<false>(addr+1,(Bit8u)(val >> 8));
+		Bit8u data[2];
+		host_writew(data,(Bit16u)val);
+		writeHandler(addr,data,2);
 	}
 	void writed(PhysPt addr,Bitu val) {
 		addr = vga.svga.bank_write_full + (PAGING_GetPhysicalAddress(addr) & 0xffff);
 		addr = CHECKED4(addr);
 		MEM_CHANGED( addr << 3 );
-		writeHandler<false>(addr+0,(Bit8u)(val >> 0));
-		writeHandler<false>(addr+1,(Bit8u)(val >> 8));
-		writeHandler<false>(addr+2,(Bit8u)(val >> 16));
-		writeHandler<false>(addr+3,(Bit8u)(val >> 24));
+		Bit8u data[4];
+		host_writed(data,(Bit32u)val);
+		writeHandler(addr,data,4);
+	}
+	bool writeblock(PhysPt addr,const Bit8u * data,Bitu count) {
+		addr = vga.svga.bank_write_full + (PAGING_GetPhysicalAddress(addr) & 0xffff);
+		addr = CHECKED4(addr);
+		if (CHECKED4(addr+count-1)!=addr+count-1) return false;
+		MEM_CHANGED_RANGE( addr << 3, (addr+count-1) << 3);
+		writeHandler(addr,data,count);
+		return true;
 	}
 	Bitu readb(PhysPt addr) {
 		addr = vga.svga.bank_read_full + (PAGING_GetPhysicalAddress(addr) & 0xffff);
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include "callback.h"
 #include "cpu.h"		// for 0x3da delay
+#include "snapshot.h"
 
 #define XGA_SCREEN_WIDTH	vga.s3.xga_screen_width
 #define XGA_COLOR_MODE		vga.s3.xga_color_mode
@@ -1220,6 +1221,20 @@ Bitu XGA_Read(Bitu port, Bitu len) {
 	return 0xffffffff; 
 }
 
+/* The accelerator registers, including a command waiting for its data */
+static void XGA_SaveState(SnapshotWriter &out) {
+	out.Write(static_cast<Bit32u>(sizeof(XGAStatus)));
+	out.Write(xga);
+}
+
+static bool XGA_LoadState(SnapshotReader &in,bool apply) {
+	Bit32u size;
+	if (!in.Read(size) || size!=sizeof(XGAStatus)) return false;
+	if (!apply) return in.Skip(size);
+	in.Read(xga);
+	return true;
+}
+
 void VGA_SetupXGA(void) {
 	if (!IS_VGA_ARCH) return;
 
@@ -1318,4 +1333,6 @@ void VGA_SetupXGA(void) {
 
 	IO_RegisterWriteHandler(0xe2ea,&XGA_Write,IO_MB | IO_MW | IO_MD);
 	IO_RegisterReadHandler(0xe2ea,&XGA_Read,IO_MB | IO_MW | IO_MD);
+
+	SNAPSHOT_Register("xga",1,XGA_SaveState,XGA_LoadState);
 }
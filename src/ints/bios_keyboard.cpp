@@ -24,6 +24,7 @@
 #include "bios.h"
 #include "keyboard.h"
 #include "regs.h"
+#include "cpu.h"
 #include "inout.h"
 #include "dos_inc.h"
 
@@ -472,8 +473,9 @@ static Bitu INT16_Handler(void) {
 			/* normal key found, return translated key in ax */
 			reg_ax=temp;
 		} else {
-			/* enter small idle loop to allow for irqs to happen */
+			/* wait in hlt for the irq that brings a key, then try again */
 			reg_ip+=1;
+			CPU_HLT(reg_eip);
 		}
 		break;
 	case 0x10: /* GET KEYSTROKE (enhanced keyboards only) */
@@ -484,8 +486,9 @@ static Bitu INT16_Handler(void) {
 			}
 			reg_ax=temp;
 		} else {
-			/* enter small idle loop to allow for irqs to happen */
+			/* wait in hlt for the irq that brings a key, then try again */
 			reg_ip+=1;
+			CPU_HLT(reg_eip);
 		}
 		break;
 	case 0x01: /* CHECK FOR KEYSTROKE */
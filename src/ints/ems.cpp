@@ -33,6 +33,7 @@
 #include "support.h"
 #include "cpu.h"
 #include "dma.h"
+#include "snapshot.h"
 
 #define EMM_PAGEFRAME	0xE000
 #define EMM_PAGEFRAME4K	((EMM_PAGEFRAME*16)/4096)
@@ -1362,6 +1363,36 @@ Bitu GetEMSType(Section_prop * section) {
 	return rtype;
 }
 
+/* The tables are stored as they are, the guest memory they refer to is
+ * part of the memory state, which gets restored before this one */
+static void EMS_SaveState(SnapshotWriter &out) {
+	out.Write(static_cast<Bit32u>(ems_type));
+	out.Write(static_cast<Bit32u>(sizeof(emm_handles)+sizeof(emm_mappings)+
+		sizeof(emm_segmentmappings)+sizeof(vcpi)));
+	out.Write(emm_handles);
+	out.Write(emm_mappings);
+	out.Write(emm_segmentmappings);
+	out.Write(&vcpi,sizeof(vcpi));
+}
+
+static bool EMS_LoadState(SnapshotReader &in,bool apply) {
+	Bit32u type,size;
+	if (!in.Read(type) || type!=ems_type) {
+		LOG_MSG("EMS: Snapshot was taken with a different EMS type");
+		return false;
+	}
+	if (!in.Read(size) || size!=sizeof(emm_handles)+sizeof(emm_mappings)+
+		sizeof(emm_segmentmappings)+sizeof(vcpi)) return false;
+	if (!apply) return in.Skip(size);
+	in.Read(emm_handles);
+	in.Read(emm_mappings);
+	in.Read(emm_segmentmappings);
+	in.Read(&vcpi,sizeof(vcpi));
+	/* Map the page frame and the mapped segments like they were */
+	EMM_RestoreMappingTable();
+	return true;
+}
+
 class EMS : public Module_base {
 private:
 	DOS_Device *emm_device = nullptr;
@@ -1441,6 +1472,8 @@ public:
 			DMA_SetWrapping(0xffffffff);	// emm386-bug that disables dma wrapping
 		}
 
+		SNAPSHOT_Register("ems",1,EMS_SaveState,EMS_LoadState);
+
 		if (!ENABLE_VCPI) return;
 
 		if (ems_type!=2) {
@@ -1492,6 +1525,7 @@ public:
 
 	~EMS() {
 		if (ems_type<=0) return;
+		SNAPSHOT_Unregister("ems");
 
 		/* Undo Biosclearing */
 		BIOS_ZeroExtendedSize(false);
@@ -29,6 +29,7 @@
 #include "inout.h"
 #include "xms.h"
 #include "bios.h"
+#include "snapshot.h"
 
 #define XMS_HANDLES							50		/* 50 XMS Memory Blocks */ 
 #define XMS_VERSION    						0x0300	/* version 3.00 */
@@ -412,6 +413,18 @@ Bitu XMS_Handler(void) {
 	return CBRET_NONE;
 }
 
+/* The handles refer to memory handles, those are part of the memory state */
+static void XMS_SaveState(SnapshotWriter &out) {
+	out.Write(static_cast<Bit32u>(sizeof(xms_handles)));
+	out.Write(xms_handles);
+}
+
+static bool XMS_LoadState(SnapshotReader &in,bool apply) {
+	Bit32u size;
+	if (!in.Read(size) || size!=sizeof(xms_handles)) return false;
+	return apply ? in.Read(xms_handles) : in.Skip(size);
+}
+
 Bitu GetEMSType(Section_prop * section);
 
 class XMS: public Module_base {
@@ -444,6 +457,7 @@ public:
 		}
 		/* Disable the 0 handle */
 		xms_handles[0].free	= false;
+		SNAPSHOT_Register("xms",1,XMS_SaveState,XMS_LoadState);
 
 		/* Set up UMB chain */
 		umb_available=section->Get_bool("umb");
@@ -461,6 +475,7 @@ public:
 		}
 
 		if (!section->Get_bool("xms")) return;
+		SNAPSHOT_Unregister("xms");
 		/* Undo biosclearing */
 		BIOS_ZeroExtendedSize(false);
 
@@ -207,6 +207,11 @@ bool MIDI_Available()
 	return midi.available;
 }
 
+bool MIDI_DeviceOpen()
+{
+	return midi.available && midi.handler != &Midi_none;
+}
+
 class MIDI : public Module_base {
 public:
 	MIDI(Section *configuration) : Module_base(configuration)
@@ -0,0 +1,208 @@
+/*
+ *  Copyright (C) 2002-2020  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "auto_cycles.h"
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+#include "cpu.h"
+#include "setup.h"
+
+/* The controlled value is log(CPU_CycleMax), the measured value is the
+ * load: host nanoseconds per emulated nanosecond, scaled up by the part of
+ * the cycles the guest really used (HLT, IO delays and DOS idle calls give
+ * theirs back through CPU_IODelayRemoved). The load is proportional to
+ * the cycles, so the error log(target / load) is in the same unit as the
+ * output and the velocity form PID below needs no further scaling. */
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr Bit64s WINDOW_NS = 100 * 1000 * 1000;    // regular window
+constexpr Bit64s WINDOW_LAG_NS = 20 * 1000 * 1000; // window while lagging
+constexpr Bit64s WINDOW_STALL_NS = 1000 * 1000 * 1000;
+
+constexpr double KP = 0.2;
+constexpr double KI = 0.5;
+constexpr double KD = 0.05;
+
+// Errors below 3% leave the cycles alone, for steady frame pacing
+constexpr double DEADBAND = 0.03;
+// Below this part of used cycles the guest is idle, the load says nothing
+constexpr double MIN_ACTIVE = 0.1;
+// A window may at most quadruple the cycles or cut them to a third
+constexpr double MAX_STEP_UP = 1.3862943611198906;    // log(4)
+constexpr double MAX_STEP_DOWN = -1.0986122886681098; // log(1/3)
+
+constexpr Bit32s CYCLES_HARD_LIMIT = 2000000;
+
+static clock_type::time_point window_start = {};
+static Bit64s window_sleep_ns = 0;
+static Bit64s window_ticks = 0;
+static double window_cycles = 0;
+static double last_error = 0;
+static double prev_error = 0;
+static Bitu errors_seen = 0;
+
+static FILE *telemetry = nullptr;
+static clock_type::time_point telemetry_start = {};
+
+static void StartWindow(clock_type::time_point now)
+{
+	window_start = now;
+	window_sleep_ns = 0;
+	window_ticks = 0;
+	window_cycles = 0;
+	CPU_IODelayRemoved = 0;
+}
+
+void AUTOCYCLES_Reset()
+{
+	StartWindow(clock_type::now());
+	last_error = prev_error = 0;
+	errors_seen = 0;
+}
+
+void AUTOCYCLES_AddTicks(Bit32u ticks)
+{
+	window_ticks += ticks;
+	window_cycles += static_cast<double>(ticks) * CPU_CycleMax;
+}
+
+void AUTOCYCLES_AddSleep(Bit64s ns)
+{
+	window_sleep_ns += ns;
+}
+
+static void WriteTelemetry(clock_type::time_point now, Bit64s wall_ns,
+                           Bit64s busy_ns, double active, double load,
+                           double target, double error, Bit32s new_cmax)
+{
+	if (!telemetry)
+		return;
+	using namespace std::chrono;
+	const auto time_ms = duration_cast<milliseconds>(now - telemetry_start).count();
+	fprintf(telemetry, "%lld,%lld,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%d,%d\n",
+	        static_cast<long long>(time_ms),
+	        static_cast<long long>(window_ticks), wall_ns / 1e6,
+	        busy_ns / 1e6, active, load, target, error,
+	        static_cast<int>(CPU_CycleMax), static_cast<int>(new_cmax));
+}
+
+bool AUTOCYCLES_Update(bool lagging)
+{
+	using namespace std::chrono;
+	const auto now = clock_type::now();
+	const Bit64s wall_ns = duration_cast<nanoseconds>(now - window_start).count();
+	if (wall_ns < (lagging ? WINDOW_LAG_NS : WINDOW_NS) || !window_ticks)
+		return false;
+
+	/* cycles=max starts from nothing */
+	if (CPU_CycleMax < CPU_CYCLES_LOWER_LIMIT || window_cycles <= 0) {
+		CPU_CycleMax = CPU_CYCLES_LOWER_LIMIT;
+		StartWindow(now);
+		return true;
+	}
+	/* The host was suspended or busy with something else entirely */
+	if (wall_ns > WINDOW_STALL_NS) {
+		StartWindow(now);
+		return true;
+	}
+
+	Bit64s busy_ns = wall_ns - window_sleep_ns;
+	if (busy_ns < 1)
+		busy_ns = 1;
+	double removed = static_cast<double>(CPU_IODelayRemoved);
+	if (removed < 0)
+		removed = 0;
+	const double active = removed < window_cycles
+	                              ? 1.0 - removed / window_cycles
+	                              : 0.0;
+	const double load = busy_ns / (window_ticks * 1e6);
+	const double target = CPU_CyclePercUsed * 0.9 / 100.0;
+
+	Bit32s new_cmax = CPU_CycleMax;
+	double error = 0;
+	if (active >= MIN_ACTIVE) {
+		error = std::log(target * active / load);
+		double step = 0;
+		if (std::fabs(error) >= DEADBAND || lagging) {
+			step = KI * error;
+			if (errors_seen > 0)
+				step += KP * (error - last_error);
+			if (errors_seen > 1)
+				step += KD * (error - 2 * last_error + prev_error);
+		}
+		if (step > MAX_STEP_UP)
+			step = MAX_STEP_UP;
+		if (step < MAX_STEP_DOWN)
+			step = MAX_STEP_DOWN;
+		const double cycles = CPU_CycleMax * std::exp(step);
+		new_cmax = cycles > CYCLES_HARD_LIMIT ? CYCLES_HARD_LIMIT
+		                                      : static_cast<Bit32s>(cycles);
+		prev_error = last_error;
+		last_error = error;
+		errors_seen++;
+	}
+
+	if (new_cmax < CPU_CYCLES_LOWER_LIMIT)
+		new_cmax = CPU_CYCLES_LOWER_LIMIT;
+	if (CPU_CycleLimit > 0) {
+		if (new_cmax > CPU_CycleLimit)
+			new_cmax = CPU_CycleLimit;
+	} else if (new_cmax > CYCLES_HARD_LIMIT) {
+		new_cmax = CYCLES_HARD_LIMIT;
+	}
+
+	LOG(LOG_CPU, LOG_NORMAL)("AUTOCYCLES: load %.3f active %.2f target %.2f error %+.3f cycles %d -> %d",
+	                         load, active, target, error,
+	                         static_cast<int>(CPU_CycleMax),
+	                         static_cast<int>(new_cmax));
+	WriteTelemetry(now, wall_ns, busy_ns, active, load, target, error, new_cmax);
+
+	CPU_CycleMax = new_cmax;
+	StartWindow(now);
+	return true;
+}
+
+static void AUTOCYCLES_Destroy(Section * /*sec*/)
+{
+	if (telemetry) {
+		fclose(telemetry);
+		telemetry = nullptr;
+	}
+}
+
+void AUTOCYCLES_Init(Section *sec)
+{
+	AUTOCYCLES_Destroy(sec);
+	AUTOCYCLES_Reset();
+	Section_prop *section = static_cast<Section_prop *>(sec);
+	const std::string &file = section->Get_path("cycles_telemetry")->realpath;
+	if (!file.empty()) {
+		telemetry = fopen(file.c_str(), "w");
+		if (telemetry) {
+			telemetry_start = clock_type::now();
+			fprintf(telemetry, "time_ms,ticks,wall_ms,busy_ms,active,load,target,error,cycles,new_cycles\n");
+		} else {
+			LOG_MSG("AUTOCYCLES: Can't create %s", file.c_str());
+		}
+	}
+	sec->AddDestroyFunction(&AUTOCYCLES_Destroy, true);
+}
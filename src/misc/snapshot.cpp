@@ -0,0 +1,315 @@
+/*
+ *  Copyright (C) 2002-2020  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "snapshot.h"
+
+#include <stdio.h>
+#include <string>
+
+#if C_SSHOT
+#include <zlib.h>
+#endif
+
+#include "mapper.h"
+#include "setup.h"
+
+/* File layout, all values in host byte order:
+ *   header    magic, format version, byte order mark, run depth, body size
+ *   body      per component: name length, name, version, size, data
+ * Components with bulky data (memory, video and sound card memory)
+ * compress it themselves. */
+
+static const char snapshot_magic[8] = {'D', 'B', 'S', 'N', 'A', 'P', 0x1a, 0};
+
+#define SNAPSHOT_FORMAT     2
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+struct SnapshotHeader {
+	char magic[8];
+	Bit32u format;
+	Bit32u byte_order;
+	Bit32u run_depth;
+	Bit32u body_size;
+};
+
+struct SnapshotComponent {
+	std::string name;
+	Bit32u version;
+	SNAPSHOT_SaveHandler *save;
+	SNAPSHOT_LoadHandler *load;
+};
+
+static std::vector<SnapshotComponent> components;
+
+static std::string snapshot_file = {};
+
+enum SnapshotRequest { SNAPSHOT_NONE, SNAPSHOT_SAVE, SNAPSHOT_LOAD };
+static SnapshotRequest pending = SNAPSHOT_NONE;
+
+void SNAPSHOT_Register(const char *name, Bit32u version,
+                       SNAPSHOT_SaveHandler *save, SNAPSHOT_LoadHandler *load)
+{
+	for (auto &component : components) {
+		if (component.name == name) {
+			component = {name, version, save, load};
+			return;
+		}
+	}
+	components.push_back({name, version, save, load});
+}
+
+void SNAPSHOT_Unregister(const char *name)
+{
+	for (auto it = components.begin(); it != components.end(); ++it) {
+		if (it->name == name) {
+			components.erase(it);
+			return;
+		}
+	}
+}
+
+/* Layout: Bit32u size, Bit8u compressed, Bit32u stored size, data */
+void SNAPSHOT_WriteBlock(SnapshotWriter &out, const void *data, size_t size)
+{
+	out.Write(static_cast<Bit32u>(size));
+#if C_SSHOT
+	std::vector<Bit8u> packed(compressBound(size));
+	uLongf packed_size = packed.size();
+	if (compress2(packed.data(), &packed_size, static_cast<const Bytef *>(data),
+	              size, Z_BEST_SPEED) == Z_OK) {
+		out.Write(static_cast<Bit8u>(1));
+		out.Write(static_cast<Bit32u>(packed_size));
+		out.Write(packed.data(), packed_size);
+		return;
+	}
+#endif
+	out.Write(static_cast<Bit8u>(0));
+	out.Write(static_cast<Bit32u>(size));
+	out.Write(data, size);
+}
+
+bool SNAPSHOT_ReadBlock(SnapshotReader &in, void *data, size_t size)
+{
+	Bit32u raw_size, stored_size;
+	Bit8u compressed;
+	if (!in.Read(raw_size) || raw_size != size || !in.Read(compressed) ||
+	    !in.Read(stored_size))
+		return false;
+	if (!compressed) {
+		if (stored_size != size)
+			return false;
+		return data ? in.Read(data, size) : in.Skip(size);
+	}
+#if C_SSHOT
+	if (compressed != 1 || stored_size > compressBound(size))
+		return false;
+	std::vector<Bit8u> packed(stored_size);
+	if (!in.Read(packed.data(), stored_size))
+		return false;
+	std::vector<Bit8u> scratch;
+	if (!data) {
+		scratch.resize(size);
+		data = scratch.data();
+	}
+	uLongf unpacked_size = size;
+	return uncompress(static_cast<Bytef *>(data), &unpacked_size,
+	                  packed.data(), stored_size) == Z_OK &&
+	       unpacked_size == size;
+#else
+	LOG_MSG("SNAPSHOT: Snapshot is compressed, this build has no zlib");
+	return false;
+#endif
+}
+
+bool SNAPSHOT_Save(const char *filename)
+{
+	SnapshotWriter body;
+	for (const auto &component : components) {
+		SnapshotWriter data;
+		component.save(data);
+		body.Write(static_cast<Bit16u>(component.name.size()));
+		body.Write(component.name.data(), component.name.size());
+		body.Write(component.version);
+		body.Write(static_cast<Bit32u>(data.buffer.size()));
+		body.Write(data.buffer.data(), data.buffer.size());
+	}
+
+	SnapshotHeader header;
+	memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+	header.format = SNAPSHOT_FORMAT;
+	header.byte_order = SNAPSHOT_BYTE_ORDER;
+	header.run_depth = static_cast<Bit32u>(DOSBOX_GetRunDepth());
+	header.body_size = static_cast<Bit32u>(body.buffer.size());
+
+	FILE *f = fopen(filename, "wb");
+	if (!f) {
+		LOG_MSG("SNAPSHOT: Can't create %s", filename);
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+	          fwrite(body.buffer.data(), body.buffer.size(), 1, f) == 1;
+	ok = (fclose(f) == 0) && ok;
+	if (!ok) {
+		LOG_MSG("SNAPSHOT: Error writing %s", filename);
+		return false;
+	}
+	LOG_MSG("SNAPSHOT: Saved %s (%u KB)", filename,
+	        static_cast<unsigned>((sizeof(header) + body.buffer.size()) / 1024));
+	return true;
+}
+
+static bool ReadBody(const char *filename, SnapshotHeader &header,
+                     std::vector<Bit8u> &body)
+{
+	FILE *f = fopen(filename, "rb");
+	if (!f) {
+		LOG_MSG("SNAPSHOT: Can't open %s", filename);
+		return false;
+	}
+	long file_size = -1;
+	if (fseek(f, 0, SEEK_END) == 0)
+		file_size = ftell(f);
+	bool ok = file_size >= static_cast<long>(sizeof(header)) &&
+	          fseek(f, 0, SEEK_SET) == 0 &&
+	          fread(&header, sizeof(header), 1, f) == 1 &&
+	          memcmp(header.magic, snapshot_magic, sizeof(header.magic)) == 0 &&
+	          header.format == SNAPSHOT_FORMAT &&
+	          header.byte_order == SNAPSHOT_BYTE_ORDER;
+	if (!ok) {
+		fclose(f);
+		LOG_MSG("SNAPSHOT: %s is not a snapshot of this DOSBox version", filename);
+		return false;
+	}
+	/* The size is checked before anything gets allocated for it */
+	ok = header.body_size == static_cast<unsigned long>(file_size) - sizeof(header);
+	if (ok) {
+		body.resize(header.body_size);
+		ok = fread(body.data(), body.size(), 1, f) == 1;
+	}
+	fclose(f);
+	if (!ok)
+		LOG_MSG("SNAPSHOT: %s is damaged", filename);
+	return ok;
+}
+
+bool SNAPSHOT_Load(const char *filename)
+{
+	SnapshotHeader header;
+	std::vector<Bit8u> body;
+	if (!ReadBody(filename, header, body))
+		return false;
+	/* The host side call stack (shell, internal programs) is not part of
+	 * the snapshot, it has to look the same as when it was taken */
+	if (header.run_depth != DOSBOX_GetRunDepth()) {
+		LOG_MSG("SNAPSHOT: %s was taken in a different program context", filename);
+		return false;
+	}
+
+	/* Split the body into the records of the registered components */
+	std::vector<std::vector<Bit8u>> records(components.size());
+	std::vector<bool> found(components.size(), false);
+	SnapshotReader in(body.data(), body.size());
+	while (!in.AtEnd()) {
+		Bit16u name_size;
+		std::string name;
+		Bit32u version, size;
+		if (!in.Read(name_size)) {
+			LOG_MSG("SNAPSHOT: %s is damaged", filename);
+			return false;
+		}
+		name.resize(name_size);
+		if (!in.Read(&name[0], name_size) || !in.Read(version) ||
+		    !in.Read(size) || size > body.size()) {
+			LOG_MSG("SNAPSHOT: %s is damaged", filename);
+			return false;
+		}
+		size_t index = 0;
+		while (index < components.size() && components[index].name != name)
+			index++;
+		if (index == components.size() || found[index]) {
+			LOG_MSG("SNAPSHOT: %s has state for %s, which this configuration lacks",
+			        filename, name.c_str());
+			return false;
+		}
+		if (components[index].version != version) {
+			LOG_MSG("SNAPSHOT: The %s state in %s has version %u",
+			        name.c_str(), filename, static_cast<unsigned>(version));
+			return false;
+		}
+		records[index].resize(size);
+		if (!in.Read(records[index].data(), size)) {
+			LOG_MSG("SNAPSHOT: %s is damaged", filename);
+			return false;
+		}
+		found[index] = true;
+	}
+
+	/* Check everything before changing anything */
+	for (size_t i = 0; i < components.size(); i++) {
+		if (!found[i]) {
+			LOG_MSG("SNAPSHOT: %s has no state for %s", filename,
+			        components[i].name.c_str());
+			return false;
+		}
+		SnapshotReader component_in(records[i].data(), records[i].size());
+		if (!components[i].load(component_in, false) || !component_in.AtEnd()) {
+			LOG_MSG("SNAPSHOT: The %s state in %s is damaged",
+			        components[i].name.c_str(), filename);
+			return false;
+		}
+	}
+	for (size_t i = 0; i < components.size(); i++) {
+		SnapshotReader component_in(records[i].data(), records[i].size());
+		components[i].load(component_in, true);
+	}
+	LOG_MSG("SNAPSHOT: Loaded %s", filename);
+	return true;
+}
+
+void SNAPSHOT_RunPending(void)
+{
+	if (GCC_LIKELY(pending == SNAPSHOT_NONE))
+		return;
+	const SnapshotRequest request = pending;
+	pending = SNAPSHOT_NONE;
+	if (request == SNAPSHOT_SAVE)
+		SNAPSHOT_Save(snapshot_file.c_str());
+	else
+		SNAPSHOT_Load(snapshot_file.c_str());
+}
+
+static void SNAPSHOT_SaveEvent(bool pressed)
+{
+	if (pressed)
+		pending = SNAPSHOT_SAVE;
+}
+
+static void SNAPSHOT_LoadEvent(bool pressed)
+{
+	if (pressed)
+		pending = SNAPSHOT_LOAD;
+}
+
+void SNAPSHOT_Init(Section *sec)
+{
+	Section_prop *section = static_cast<Section_prop *>(sec);
+	Prop_path *path = section->Get_path("snapshot");
+	snapshot_file = path->realpath;
+	MAPPER_AddHandler(SNAPSHOT_SaveEvent, MK_f5, MMOD2, "savestate", "Save State");
+	MAPPER_AddHandler(SNAPSHOT_LoadEvent, MK_f9, MMOD2, "loadstate", "Load State");
+}